@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/systimer.h>
+#include <kernel/clock.h>
+
+// Number of delay loop iterations used for calibration (doubled until the
+// measurement spans enough clock ticks).
+#define CALIBRATION_LOOPS 0x1000
+
+// Minimum number of clock ticks for a calibration measurement.
+#define CALIBRATION_MIN_TICKS 1000
+
+static bool initialised = false;
+static u64 source = CLOCK_GENERIC_TIMER;
+static u64 freq = 0;
+static u64 loops_per_ms = 0;
+
+// Read the 64-bit counter of the system timer (the high word is read twice in
+// case the low word wraps around in the meantime).
+static u64 systimer_ticks(){
+  u32 hi = *SYSTIMER_CHI;
+  u32 lo = *SYSTIMER_CLO;
+  u32 hi2 = *SYSTIMER_CHI;
+  if(hi2 != hi) lo = *SYSTIMER_CLO;
+  return ((u64) hi2 << 32) | lo;
+}
+
+// Busy-wait loop running exactly n iterations (its speed does not depend on
+// the code generated by the compiler, only on the CPU).
+static void delay_loop(u64 n){
+  if(n == 0) return;
+  asm volatile(
+    "1: subs %0, %0, #1\n"
+    "   b.ne 1b\n"
+    : "+r" (n)
+    :
+    : "cc"
+  );
+}
+
+// Indicates whether the generic timer counter runs.
+static bool generic_timer_runs(){
+  u64 start = counter_ticks();
+  for(u64 i = 0; i < 1000; i++){
+    if(counter_ticks() != start) return true;
+  }
+  return false;
+}
+
+void clock_init(){
+  freq = read_cntfrq_el0();
+  if(freq != 0 && generic_timer_runs()){
+    source = CLOCK_GENERIC_TIMER;
+  } else {
+    source = CLOCK_SYSTEM_TIMER;
+    freq = SYSTIMER_FREQ;
+  }
+  initialised = true;
+
+  // Calibrate the delay loop.
+  u64 loops = CALIBRATION_LOOPS;
+  while(1){
+    u64 start = clock_ticks();
+    delay_loop(loops);
+    u64 ticks = clock_ticks() - start;
+
+    if(ticks >= CALIBRATION_MIN_TICKS){
+      loops_per_ms = loops * freq / (ticks * 1000);
+      break;
+    }
+    loops *= 2;
+  }
+  if(loops_per_ms == 0) loops_per_ms = 1;
+}
+
+u64 clock_source(){
+  if(!initialised) clock_init();
+  return source;
+}
+
+u64 clock_freq(){
+  if(!initialised) clock_init();
+  return freq;
+}
+
+u64 clock_loops_per_ms(){
+  if(!initialised) clock_init();
+  return loops_per_ms;
+}
+
+u64 clock_ticks(){
+  if(!initialised) clock_init();
+  return source == CLOCK_GENERIC_TIMER ? counter_ticks() : systimer_ticks();
+}
+
+u64 now_ns(){
+  u64 t = clock_ticks();
+  // Avoid overflows (t * 1000000000 would overflow after a few minutes).
+  return (t / freq) * 1000000000ULL + (t % freq) * 1000000000ULL / freq;
+}
+
+void ndelay(u64 ns){
+  if(!initialised) clock_init();
+
+  // Short delays: use the calibrated loop (rounding up).
+  u64 period_ns = 1000000000ULL / freq;
+  if(ns < 2 * period_ns){
+    delay_loop((ns * loops_per_ms + 999999) / 1000000);
+    return;
+  }
+
+  // Otherwise, poll the counter. An elapsed count of n + 1 ticks guarantees
+  // that at least n full tick periods have passed.
+  u64 ticks = (ns * freq + 999999999ULL) / 1000000000ULL;
+  u64 start = clock_ticks();
+  while(clock_ticks() - start <= ticks);
+}
+
+void udelay(u64 us){
+  // Avoid overflows in "ndelay" for long delays.
+  while(us > 1000000){
+    ndelay(1000000000ULL);
+    us -= 1000000;
+  }
+  ndelay(us * 1000);
+}
@@ -1,8 +1,85 @@
+#include <stdbool.h>
+#include <macros.h>
 #include <types.h>
 #include <string.h>
 #include <util.h>
+#include <crc32.h>
+#include <aarch64/atomic.h>
+#include <aarch64/cache.h>
+#include <aarch64/pmu.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/gpio.h>
+#include <bcm2837/local.h>
 #include <bcm2837/uart1.h>
 #include <kernel/commands.h>
+#include <kernel/console.h>
+#include <kernel/gpiocap.h>
+#include <kernel/guest.h>
+#include <kernel/hvc.h>
+#include <kernel/ipi.h>
+#include <kernel/irq.h>
+#include <kernel/mmiotrace.h>
+#include <kernel/percpu.h>
+#include <kernel/perf.h>
+#include <kernel/prof.h>
+#include <kernel/queue.h>
+#include <kernel/smp.h>
+#include <kernel/symbols.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/twheel.h>
+#include <kernel/vuart.h>
+#include <kernel/wsched.h>
+
+// Start of the data of our kernel image, end of its BSS, start of the memory
+// private to EL2, and end of the image in memory (defined in "kernel8.ld").
+extern char __text_start[];
+extern char __data_start[];
+extern char __bss_end[];
+extern char __hyp_start[];
+extern char __end[];
+
+// Start of the free memory following the kernel image (aligned on 1MB), which
+// is used as scratch space by benchmarks.
+static u8 *scratch_memory(){
+  return (u8 *) (((u64) __end + 0xfffffULL) & ~0xfffffULL);
+}
+
+// Parse a decimal, or hexadecimal (with "0x" prefix) integer into res.
+// Returns true on success, and false otherwise.
+static bool parse_u64(const char *s, u64 *res){
+  char *end;
+  if(s[0] == '0' && s[1] == 'x'){
+    *res = strtou64(s + 2, &end, 16);
+  } else {
+    *res = strtou64(s, &end, 10);
+  }
+  return end == NULL;
+}
+
+// Convert a number of generic timer ticks into microseconds.
+static u64 ticks_to_us(u64 ticks){
+  return ticks * 1000000 / read_cntfrq_el0();
+}
+
+// Convert a number of generic timer ticks into nanoseconds.
+static u64 ticks_to_ns(u64 ticks){
+  return ticks * 1000000000 / read_cntfrq_el0();
+}
+
+cmd_descr *cmd_find(const char *name){
+  for(cmd_descr *d = cmds; d->name != NULL; d++){
+    if(strcmp(name, d->name) == 0) return d;
+  }
+  return NULL;
+}
+
+// Work reported by the command running on the core (see "cmd_report_work").
+static DEFINE_PER_CPU(u64, cmd_work);
+
+void cmd_report_work(u64 units){
+  *this_cpu_ptr(cmd_work) += units;
+}
 
 int help(size_t argc, char **argv){
   if(argc > 1){
@@ -90,7 +167,7 @@ int inc(size_t argc, char **argv){
     return 1;
   }
 
-  asm volatile("hvc #42");
+  hvc_call(HVC_COUNTER_INC, 0, 0, 0);
   return 0;
 }
 
@@ -100,18 +177,2390 @@ int get(size_t argc, char **argv){
     return 1;
   }
 
-  u64 v = 0;
-  asm volatile(
-    "hvc #73;"
-    "ldr %[res], [sp];"
-    "add sp, sp, #0x10;"
-    : [res] "=r" (v)
-  );
+  i64 v = hvc_call(HVC_COUNTER_GET, 0, 0, 0);
 
   uart1_printf("The secret counter has value %i\n", (int) v);
   return 0;
 }
 
+// Default number of calls done by "hvcbench" (for each measurement).
+#define HVCBENCH_DEFAULT_CALLS 100000
+
+// Plain function calls equivalent to the hypercalls measured by "hvcbench".
+static volatile u64 hvcbench_counter = 0;
+
+static i64 hvcbench_null(u64 a1, u64 a2, u64 a3){
+  UNUSED(a1);
+  UNUSED(a2);
+  UNUSED(a3);
+  return 0;
+}
+
+static i64 hvcbench_inc(u64 a1, u64 a2, u64 a3){
+  UNUSED(a1);
+  UNUSED(a2);
+  UNUSED(a3);
+  hvcbench_counter++;
+  return 0;
+}
+
+static i64 hvcbench_get(u64 a1, u64 a2, u64 a3){
+  UNUSED(a1);
+  UNUSED(a2);
+  UNUSED(a3);
+  return (i64) hvcbench_counter;
+}
+
+// Hypercalls measured by "hvcbench", with the equivalent functions (called
+// through a pointer, like the handlers of the EL2 jump table).
+static const struct {
+  const char *name;
+  u64 id;
+  i64 (*fn)(u64 a1, u64 a2, u64 a3);
+} hvcbench_calls[] = {
+  { "null", HVC_NULL,        hvcbench_null },
+  { "inc",  HVC_COUNTER_INC, hvcbench_inc  },
+  { "get",  HVC_COUNTER_GET, hvcbench_get  }
+};
+
+// Print the cost of one call, given the time (timer ticks) and PMU cycles for
+// n calls (PMU cycles are not shown if the cycle counter does not run).
+static void hvcbench_print(u64 n, u64 ticks, u64 cycles){
+  uart1_printf("\t%u", ticks_to_ns(ticks) / n);
+  if(cycles == 0){
+    uart1_printf("\t-");
+  } else {
+    uart1_printf("\t%u", cycles / n);
+  }
+}
+
+int hvcbench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 n = HVCBENCH_DEFAULT_CALLS;
+  if(argc == 2 && (!parse_u64(argv[1], &n) || n == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of calls.\n");
+    return 1;
+  }
+
+  uart1_printf("Cost of one call (%u calls, IRQs masked):\n", n);
+  uart1_printf("CALL\tHVC(ns)\tHVC(cyc)\tFN(ns)\tFN(cyc)\n");
+
+  // The "inc" hypercalls increment the counter of the hypervisor n times.
+  i64 counter = hvc_call(HVC_COUNTER_GET, 0, 0, 0);
+
+  u64 nb = sizeof(hvcbench_calls) / sizeof(hvcbench_calls[0]);
+  for(u64 c = 0; c < nb; c++){
+    u64 id = hvcbench_calls[c].id;
+    i64 (*fn)(u64, u64, u64) = hvcbench_calls[c].fn;
+    u64 flags = irq_save();
+
+    u64 start = counter_ticks();
+    u64 start_cycles = pmu_cycles();
+    for(u64 i = 0; i < n; i++){
+      hvc_call(id, i, 0, 0);
+    }
+    u64 hvc_cycles = pmu_cycles() - start_cycles;
+    u64 hvc_ticks = counter_ticks() - start;
+
+    start = counter_ticks();
+    start_cycles = pmu_cycles();
+    for(u64 i = 0; i < n; i++){
+      fn(i, 0, 0);
+    }
+    u64 fn_cycles = pmu_cycles() - start_cycles;
+    u64 fn_ticks = counter_ticks() - start;
+
+    irq_restore(flags);
+
+    uart1_printf("%s", hvcbench_calls[c].name);
+    hvcbench_print(n, hvc_ticks, hvc_cycles);
+    hvcbench_print(n, fn_ticks, fn_cycles);
+    uart1_printf("\n");
+  }
+
+  uart1_printf("(The hypervisor counter went from %u to %u.)\n", (u64) counter,
+               (u64) hvc_call(HVC_COUNTER_GET, 0, 0, 0));
+  return 0;
+}
+
+// Default number of operations done by "hvcbatch" (for each measurement).
+#define HVCBATCH_DEFAULT_OPS 0x10000
+
+// Batch sizes compared by "hvcbatch".
+static const u64 hvcbatch_sizes[] = { 1, 8, 64, 512 };
+
+// Ring used by "hvcbatch" on each core.
+static hvc_ring hvcbatch_rings[NB_CORES];
+
+// Print the cost of an operation, and the throughput, for n operations taking
+// the given time (timer ticks).
+static void hvcbatch_print(const char *method, u64 batch, u64 n, u64 ticks){
+  if(ticks == 0) ticks = 1;
+  uart1_printf("%s\t%u\t%u\t%u\n", method, batch, ticks_to_ns(ticks) / n,
+               n * read_cntfrq_el0() / ticks);
+}
+
+int hvcbatch(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 n = HVCBATCH_DEFAULT_OPS;
+  if(argc == 2 && (!parse_u64(argv[1], &n) || n == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of operations.\n");
+    return 1;
+  }
+
+  hvc_ring *r = &(hvcbatch_rings[smp_core_id()]);
+  if(!hvc_ring_setup(r)){
+    uart1_printf("Error: the ring could not be set up.\n");
+    return 1;
+  }
+
+  uart1_printf("%u increments of the hypervisor counter (IRQs masked):\n", n);
+  uart1_printf("METHOD\tBATCH\tNS/OP\tOPS/S\n");
+  i64 before = hvc_call(HVC_COUNTER_GET, 0, 0, 0);
+  u64 flags = irq_save();
+
+  // One trap per operation.
+  u64 start = counter_ticks();
+  for(u64 i = 0; i < n; i++){
+    hvc_call(HVC_COUNTER_INC, 0, 0, 0);
+  }
+  u64 ticks = counter_ticks() - start;
+  hvcbatch_print("trap", 1, n, ticks);
+
+  // One trap per batch.
+  bool ok = true;
+  u64 nb_sizes = sizeof(hvcbatch_sizes) / sizeof(hvcbatch_sizes[0]);
+  for(u64 s = 0; s < nb_sizes; s++){
+    u64 batch = hvcbatch_sizes[s];
+    start = counter_ticks();
+    for(u64 done = 0; done < n; done += batch){
+      u64 k = n - done < batch ? n - done : batch;
+      for(u64 i = 0; i < k; i++){
+        hvc_ring_push(r, HVC_COUNTER_INC, 0, 0, 0);
+      }
+      if(hvc_ring_submit() != (i64) k) ok = false;
+    }
+    ticks = counter_ticks() - start;
+    hvcbatch_print("ring", batch, n, ticks);
+  }
+
+  irq_restore(flags);
+
+  // Check the completions of the last batch, and the counter.
+  u64 last = n % HVC_RING_SIZE == 0 ? HVC_RING_SIZE : n % HVC_RING_SIZE;
+  for(u64 i = r->tail - last; i != r->tail; i++){
+    if(r->ops[i % HVC_RING_SIZE].result != 0) ok = false;
+  }
+  u64 expected = (nb_sizes + 1) * n;
+  u64 got = (u64) (hvc_call(HVC_COUNTER_GET, 0, 0, 0) - before);
+  if(!ok || got != expected){
+    uart1_printf("Error: %u increments done, %u expected.\n", got, expected);
+    return 1;
+  }
+  return 0;
+}
+
+int stage2(size_t argc, char **argv){
+  bool probe = argc == 2 && strcmp(argv[1], "probe") == 0;
+  if(argc > 2 || (argc == 2 && !probe)){
+    uart1_printf("Error: usage is \"%s [probe]\".\n", argv[0]);
+    return 1;
+  }
+
+  // Read from the memory private to EL2: the load should fault, and return 0.
+  if(probe){
+    u64 v = *((volatile u64 *) __hyp_start);
+    uart1_printf("Read 0x%w at 0x%w (last fault at IPA 0x%w).\n", v,
+                 (u64) __hyp_start, (u64) hvc_call(HVC_S2_LAST, 0, 0, 0));
+  }
+
+  u64 res[3];
+  i64 translation = hvc_call_res(HVC_S2_STATS, 0, 0, 0, res);
+  uart1_printf("Stage-2 faults: %u translation, %u permission, %u not "
+               "emulated.\n", (u64) translation, res[0], res[1]);
+  uart1_printf("Blocks split into 4KB pages: %u.\n", res[2]);
+  return 0;
+}
+
+// Write n lines directly to the UART (bypassing the console core), and return
+// the time spent at EL1 (in ticks).
+static u64 vuart_lines(u64 n){
+  const char *line = "The quick brown fox jumps over the lazy dog.\r\n";
+  u64 start = counter_ticks();
+  for(u64 i = 0; i < n; i++){
+    for(const char *c = line; *c; c++) uart1_raw_putc(*c);
+  }
+  return counter_ticks() - start;
+}
+
+int vuart(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: usage is \"%s [on|off|bench]\".\n", argv[0]);
+    return 1;
+  }
+
+  if(argc == 2 && strcmp(argv[1], "bench") == 0){
+    // Measure with direct accesses, and then with emulation (the flush is
+    // timed separately, as it only delays the UART, and not EL1). The mode
+    // is restored afterwards.
+    u64 n = 16;
+    bool was_on = hvc_call(HVC_VUART_CTL, VUART_STATE, 0, 0) == 1;
+    hvc_call(HVC_VUART_CTL, VUART_OFF, 0, 0);
+    u64 direct = vuart_lines(n);
+    hvc_call(HVC_VUART_CTL, VUART_ON, 0, 0);
+    u64 emulated = vuart_lines(n);
+    u64 start = counter_ticks();
+    hvc_call(HVC_VUART_CTL, VUART_FLUSH, 0, 0);
+    u64 flush = counter_ticks() - start;
+    if(!was_on) hvc_call(HVC_VUART_CTL, VUART_OFF, 0, 0);
+    uart1_printf("%u lines: %uus direct, %uus emulated (then %uus to "
+                 "flush).\n", n, ticks_to_us(direct), ticks_to_us(emulated),
+                 ticks_to_us(flush));
+  } else if(argc == 2){
+    bool on = strcmp(argv[1], "on") == 0;
+    if(!on && strcmp(argv[1], "off") != 0){
+      uart1_printf("Error: usage is \"%s [on|off|bench]\".\n", argv[0]);
+      return 1;
+    }
+    if(hvc_call(HVC_VUART_CTL, on ? VUART_ON : VUART_OFF, 0, 0) != 0){
+      uart1_printf("Error: cannot change the mode of the virtual UART.\n");
+      return 1;
+    }
+  }
+
+  u64 res[3];
+  i64 traps = hvc_call_res(HVC_VUART_STATS, 0, 0, 0, res);
+  uart1_printf("Virtual UART: %u traps, %u chars, %u batches (max %u).\n",
+               (u64) traps, res[0], res[1], res[2]);
+  return 0;
+}
+
+// Guests run by the "guests" command: each one computes the CRC of the first
+// 4KB of the kernel code a different number of times.
+#define GUESTS_NB         3
+#define GUESTS_ROUNDS     64
+#define GUESTS_STACK_SIZE 0x4000
+#define GUESTS_DEFAULT_SLICE_US 1000
+
+static u8 guests_stacks[GUESTS_NB][GUESTS_STACK_SIZE]
+  __attribute__((aligned(16)));
+static guest_info guests_info[GUESTS_NB];
+
+static u64 guests_crc(u64 rounds){
+  u32 crc = 0;
+  for(u64 i = 0; i < rounds; i++){
+    crc = crc32_update(crc, (const u8 *) __text_start, 4096);
+  }
+  return crc;
+}
+
+int guests(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 slice = GUESTS_DEFAULT_SLICE_US;
+  if(argc == 2 && (!parse_u64(argv[1], &slice) || slice == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of microseconds.\n");
+    return 1;
+  }
+
+  if(hvc_call(HVC_GUEST_RESET, 0, 0, 0) != 0){
+    uart1_printf("Error: cannot remove the previous guests.\n");
+    return 1;
+  }
+  for(u64 i = 0; i < GUESTS_NB; i++){
+    guest_info *g = &(guests_info[i]);
+    g->entry = (u64) guests_crc;
+    g->arg = (i + 1) * GUESTS_ROUNDS;
+    g->stack_top = (u64) (guests_stacks[i] + GUESTS_STACK_SIZE);
+    if(hvc_call(HVC_GUEST_ADD, (u64) g, 0, 0) < 0){
+      uart1_printf("Error: cannot create guest %u.\n", i);
+      return 1;
+    }
+  }
+
+  // Run the guests until they have all exited, letting the host handle its
+  // interrupts whenever they are pending.
+  u64 runs = 0;
+  u64 start = counter_ticks();
+  i64 ready;
+  do {
+    ready = hvc_call(HVC_GUEST_RUN, slice, 0, 0);
+    runs++;
+  } while(ready > 0);
+  u64 ticks = counter_ticks() - start;
+  if(ready < 0){
+    uart1_printf("Error: cannot run the guests.\n");
+    return 1;
+  }
+
+  bool ok = true;
+  uart1_printf("GUEST\tROUNDS\tSTATE\tCPU(us)\tSLICES\tVIRQS\tRESULT\n");
+  for(u64 i = 0; i < GUESTS_NB; i++){
+    guest_info *g = &(guests_info[i]);
+    bool good = g->state == GUEST_EXITED && g->result == guests_crc(g->arg);
+    ok = ok && good;
+    uart1_printf("%u\t%u\t%s\t%u\t%u\t%u\t0x%w (%s)\n", i, g->arg,
+                 g->state == GUEST_EXITED ? "exited" : "faulted",
+                 ticks_to_us(g->cpu_ticks), g->nb_slices, g->nb_virqs,
+                 g->result, good ? "ok" : "wrong");
+  }
+
+  u64 res[3];
+  u64 switches = (u64) hvc_call_res(HVC_GUEST_STATS, 0, 0, 0, res);
+  uart1_printf("Total: %u us, %u runs (%u preempted by the host).\n",
+               ticks_to_us(ticks), runs, res[2]);
+  if(switches != 0){
+    uart1_printf("World switches: %u, latency %u ns on average, %u ns max.\n",
+                 switches, ticks_to_ns(res[0]) / switches,
+                 ticks_to_ns(res[1]));
+  }
+  return ok ? 0 : 1;
+}
+
+int pool(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  if(argc == 2){
+    u64 n;
+    if(!parse_u64(argv[1], &n) || n < 1 || n > NB_CORES){
+      uart1_printf("Error: ARG1 should be between 1 and %i.\n", NB_CORES);
+      return 1;
+    }
+    wsched_set_cores(n);
+  }
+
+  uart1_printf("The pool uses %u core(s) (%u online).\n",
+               wsched_cores(), smp_nb_online());
+  return 0;
+}
+
+// Size of the chunks of memory processed by a single task of "parallel_crc".
+#define CRC_CHUNK_SIZE 0x10000ULL
+
+// Maximum number of chunks processed by "parallel_crc".
+#define CRC_MAX_CHUNKS 4096
+
+// State shared by the tasks of "parallel_crc".
+typedef struct {
+  const u8 *buf;             // Start of the buffer.
+  u64 size;                  // Size of the buffer.
+  u32 crcs[CRC_MAX_CHUNKS];  // CRC of each chunk.
+} crc_job;
+
+static crc_job crc_job_data;
+
+// Task computing the CRC of chunks begin to end-1.
+static void crc_chunks(u64 begin, u64 end, void *arg){
+  crc_job *job = (crc_job *) arg;
+
+  for(u64 i = begin; i < end; i++){
+    u64 off = i * CRC_CHUNK_SIZE;
+    u64 len = job->size - off;
+    if(len > CRC_CHUNK_SIZE) len = CRC_CHUNK_SIZE;
+    job->crcs[i] = crc32_update(0, job->buf + off, len);
+  }
+}
+
+// Compute the CRC of the given buffer, whose size must be at most equal to
+// CRC_CHUNK_SIZE * CRC_MAX_CHUNKS, using the work-stealing pool.
+static u32 parallel_crc(const u8 *buf, u64 size){
+  if(size == 0) return 0;
+
+  crc_job *job = &crc_job_data;
+  job->buf  = buf;
+  job->size = size;
+
+  u64 nb_chunks = (size + CRC_CHUNK_SIZE - 1) / CRC_CHUNK_SIZE;
+  parallel_for(0, nb_chunks, 1, crc_chunks, job);
+
+  // Combine the CRCs of the chunks (all but the last have the same size).
+  u32 op[32];
+  crc32_combine_gen(op, CRC_CHUNK_SIZE);
+  u32 crc = job->crcs[0];
+  for(u64 i = 1; i < nb_chunks - 1; i++){
+    crc = crc32_combine_op(op, crc, job->crcs[i]);
+  }
+  if(nb_chunks > 1){
+    u64 last = size - (nb_chunks - 1) * CRC_CHUNK_SIZE;
+    crc = crc32_combine(crc, job->crcs[nb_chunks - 1], last);
+  }
+
+  return crc;
+}
+
+int crc(size_t argc, char **argv){
+  if(argc != 3){
+    uart1_printf("Error: \"%s\" expects two integer arguments.\n", argv[0]);
+    return 1;
+  }
+
+  u64 addr, size;
+  if(!parse_u64(argv[1], &addr)){
+    uart1_printf("Error: ARG1 should be a decimal or hex address.\n");
+    return 1;
+  }
+  if(!parse_u64(argv[2], &size) || size > CRC_CHUNK_SIZE * CRC_MAX_CHUNKS){
+    uart1_printf("Error: ARG2 should be a size of at most %u bytes.\n",
+                 CRC_CHUNK_SIZE * CRC_MAX_CHUNKS);
+    return 1;
+  }
+
+  u64 start = counter_ticks();
+  u32 res = parallel_crc((const u8 *) addr, size);
+  u64 time = counter_ticks() - start;
+
+  uart1_printf("CRC-32: 0x%h (%u us on %u core(s)).\n",
+               res, ticks_to_us(time), wsched_cores());
+  return 0;
+}
+
+// Default size of the buffer used by "wsbench".
+#define WSBENCH_DEFAULT_SIZE 0x800000ULL
+
+int wsbench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 size = WSBENCH_DEFAULT_SIZE;
+  if(argc == 2){
+    if(!parse_u64(argv[1], &size) || size == 0 ||
+       size > CRC_CHUNK_SIZE * CRC_MAX_CHUNKS){
+      uart1_printf("Error: ARG1 should be a size of at most %u bytes.\n",
+                   CRC_CHUNK_SIZE * CRC_MAX_CHUNKS);
+      return 1;
+    }
+  }
+
+  // Fill the buffer with pseudo-random data.
+  u8 *buf = scratch_memory();
+  u64 x = 0x2545f4914f6cdd1dULL;
+  for(u64 i = 0; i < size; i++){
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    buf[i] = (u8) x;
+  }
+
+  uart1_printf("CRC-32 of %u bytes at 0x%w.\n", size, (u64) buf);
+
+  u64 saved_cores = wsched_cores();
+  u64 ref_time = 0;
+  u32 ref_crc = 0;
+
+  for(u64 n = 1; n <= smp_nb_online(); n++){
+    wsched_set_cores(n);
+    wsched_reset_stats();
+
+    u64 start = counter_ticks();
+    u32 res = parallel_crc(buf, size);
+    u64 time = counter_ticks() - start;
+    if(time == 0) time = 1;
+
+    if(n == 1){
+      ref_time = time;
+      ref_crc = res;
+    }
+
+    u64 steals = 0;
+    for(u64 core = 0; core < n; core++){
+      steals += wsched_nb_steals(core);
+    }
+
+    u64 speedup = ref_time * 100 / time; // In hundredths.
+    uart1_printf("%u core(s): %u us, %u MB/s, speedup %u.%u%ux, %u steals%s\n",
+                 n, ticks_to_us(time),
+                 size * read_cntfrq_el0() / time / 1000000,
+                 speedup / 100, (speedup / 10) % 10, speedup % 10, steals,
+                 res == ref_crc ? "" : " (CRC MISMATCH)");
+  }
+
+  wsched_set_cores(saved_cores);
+  return 0;
+}
+
+// Default number of round trips measured by "ctxbench".
+#define CTXBENCH_DEFAULT_ROUNDS 10000
+
+// Set to stop the partner thread of "ctxbench".
+static volatile bool ctxbench_done;
+
+// Partner thread of "ctxbench": gives the CPU back until told to stop.
+static void ctxbench_partner(void *arg){
+  UNUSED(arg);
+  while(!ctxbench_done){
+    thread_yield();
+  }
+}
+
+int ctxbench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 rounds = CTXBENCH_DEFAULT_ROUNDS;
+  if(argc == 2 && (!parse_u64(argv[1], &rounds) || rounds == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of rounds.\n");
+    return 1;
+  }
+
+  ctxbench_done = false;
+  if(!thread_create("ctxbench", PRIO_DEFAULT, ctxbench_partner, NULL)){
+    uart1_printf("Error: could not create a thread.\n");
+    return 1;
+  }
+  thread_yield(); // Let the partner start.
+
+  // Each round trip consists of two switches (to the partner, and back),
+  // assuming no other thread is ready.
+  u64 start = pmu_cycles();
+  for(u64 i = 0; i < rounds; i++){
+    thread_yield();
+  }
+  u64 cycles = pmu_cycles() - start;
+
+  // Let the partner terminate.
+  ctxbench_done = true;
+  thread_yield();
+
+  uart1_printf("%u round trips in %u cycles.\n", rounds, cycles);
+  uart1_printf("Cost of a switch (yield included): %u cycles.\n",
+               cycles / (2 * rounds));
+  return 0;
+}
+
+// Default number of round trips measured by "ipibench" (for each core pair).
+#define IPIBENCH_DEFAULT_ROUNDS 1000
+
+// Parameters and result of an "ipibench" measurement.
+typedef struct {
+  u64 target; // Target core.
+  u64 rounds; // Number of round trips.
+  u64 cycles; // Total number of cycles (on the source core), or 0 on error.
+} ipibench_job;
+
+// Function called on the target core (the cost of the call is negligible).
+static void ipibench_nop(void *arg){
+  UNUSED(arg);
+}
+
+// Measure IPI round trips from the calling core to the target.
+static void ipibench_run(void *arg){
+  ipibench_job *job = (ipibench_job *) arg;
+
+  u64 start = pmu_cycles();
+  for(u64 i = 0; i < job->rounds; i++){
+    if(!smp_call_function(job->target, ipibench_nop, NULL)){
+      job->cycles = 0;
+      return;
+    }
+  }
+  job->cycles = pmu_cycles() - start;
+}
+
+int ipibench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 rounds = IPIBENCH_DEFAULT_ROUNDS;
+  if(argc == 2 && (!parse_u64(argv[1], &rounds) || rounds == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of rounds.\n");
+    return 1;
+  }
+
+  uart1_printf("IPI round trip (cycles), from row core to column core:\n");
+  uart1_printf("from\\to");
+  for(u64 target = 0; target < NB_CORES; target++){
+    uart1_printf("\t%u", target);
+  }
+  uart1_printf("\n");
+
+  for(u64 source = 0; source < NB_CORES; source++){
+    if(!smp_is_online(source)) continue;
+    uart1_printf("%u", source);
+
+    for(u64 target = 0; target < NB_CORES; target++){
+      if(target == source || !smp_is_online(target)){
+        uart1_printf("\t-");
+        continue;
+      }
+
+      ipibench_job job = { .target = target, .rounds = rounds, .cycles = 0 };
+      if(source == smp_core_id()){
+        ipibench_run(&job);
+      } else if(smp_run_on(source, ipibench_run, &job)){
+        smp_wait(source);
+      }
+
+      if(job.cycles == 0){
+        uart1_printf("\terror");
+      } else {
+        uart1_printf("\t%u", job.cycles / rounds);
+      }
+    }
+    uart1_printf("\n");
+  }
+
+  return 0;
+}
+
+// Default number of messages sent by "qbench" (for each measurement).
+#define QBENCH_DEFAULT_COUNT 0x100000
+
+// Number of messages pushed or popped at once by "qbench".
+#define QBENCH_BATCH 32
+
+// Capacity of the queues used by "qbench".
+#define QBENCH_CAPACITY 1024
+
+SPSC_QUEUE_DEFINE(qbench_spsc, u64, QBENCH_CAPACITY)
+MPSC_QUEUE_DEFINE(qbench_mpsc, u64, QBENCH_CAPACITY)
+
+static qbench_spsc qbench_spsc_queue;
+static qbench_mpsc qbench_mpsc_queue;
+
+// Parameters of a "qbench" measurement.
+typedef struct {
+  bool mpsc;             // Use the MPSC queue (instead of the SPSC one)?
+  u64 count;             // Number of messages sent by each producer.
+  u64 nb_producers;      // Number of producers.
+  volatile bool corrupt; // Set by the consumer if messages are corrupted.
+} qbench_job;
+
+// Producer: messages are the producer's core in the upper 16 bits, and a
+// sequence number in the lower bits.
+static void qbench_producer(void *arg){
+  qbench_job *job = (qbench_job *) arg;
+  u64 tag = smp_core_id() << 48;
+  u64 batch[QBENCH_BATCH];
+
+  u64 sent = 0;
+  while(sent < job->count){
+    u64 n = job->count - sent;
+    if(n > QBENCH_BATCH) n = QBENCH_BATCH;
+    for(u64 i = 0; i < n; i++){
+      batch[i] = tag | (sent + i);
+    }
+
+    u64 *cur = batch;
+    u64 left = n;
+    while(left > 0){
+      u64 done;
+      if(job->mpsc){
+        done = qbench_mpsc_push_bulk(&qbench_mpsc_queue, cur, left);
+      } else {
+        done = qbench_spsc_push_bulk(&qbench_spsc_queue, cur, left);
+      }
+      cur += done;
+      left -= done;
+    }
+    sent += n;
+  }
+}
+
+// Consumer: checks that the messages of each producer arrive in order.
+static void qbench_consumer(void *arg){
+  qbench_job *job = (qbench_job *) arg;
+  u64 next[NB_CORES] = { 0 };
+  u64 batch[QBENCH_BATCH];
+
+  u64 total = job->count * job->nb_producers;
+  u64 received = 0;
+  while(received < total){
+    u64 n;
+    if(job->mpsc){
+      n = qbench_mpsc_pop_bulk(&qbench_mpsc_queue, batch, QBENCH_BATCH);
+    } else {
+      n = qbench_spsc_pop_bulk(&qbench_spsc_queue, batch, QBENCH_BATCH);
+    }
+
+    for(u64 i = 0; i < n; i++){
+      u64 core = batch[i] >> 48;
+      if(core >= NB_CORES || (batch[i] & 0xffffffffffffULL) != next[core]){
+        job->corrupt = true;
+      } else {
+        next[core]++;
+      }
+    }
+    received += n;
+  }
+}
+
+// Run the given producers (mask of cores) and consumer, and return the time
+// taken (in timer ticks), or 0 if some core could not be used.
+static u64 qbench_run(qbench_job *job, u64 producers, u64 consumer){
+  u64 self = smp_core_id();
+  u64 used = producers | (1ULL << consumer);
+
+  qbench_spsc_init(&qbench_spsc_queue);
+  qbench_mpsc_init(&qbench_mpsc_queue);
+  job->corrupt = false;
+
+  u64 started = 0;
+  u64 start = counter_ticks();
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(core == self || !((used >> core) & 1)) continue;
+    smp_fn fn = core == consumer ? qbench_consumer : qbench_producer;
+    if(smp_run_on(core, fn, job)) started |= 1ULL << core;
+  }
+
+  // If a core could not be started, the others may never finish.
+  if(started != (used & ~(1ULL << self))){
+    uart1_printf("Error: core(s) busy, the system must be restarted.\n");
+    return 0;
+  }
+
+  if((used >> self) & 1){
+    if(self == consumer){
+      qbench_consumer(job);
+    } else {
+      qbench_producer(job);
+    }
+  }
+
+  for(u64 core = 0; core < NB_CORES; core++){
+    if((started >> core) & 1) smp_wait(core);
+  }
+  return counter_ticks() - start;
+}
+
+// Print a throughput, in millions of messages per second.
+static void qbench_print_rate(qbench_job *job, u64 ticks){
+  u64 us = ticks_to_us(ticks);
+  if(us == 0) us = 1;
+  u64 rate = job->count * job->nb_producers * 100 / us; // In hundredths.
+  uart1_printf("\t%u.%u%u%s", rate / 100, (rate / 10) % 10, rate % 10,
+               job->corrupt ? "!" : "");
+}
+
+int qbench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  qbench_job job = { .mpsc = false, .count = QBENCH_DEFAULT_COUNT,
+                     .nb_producers = 1, .corrupt = false };
+  if(argc == 2 && (!parse_u64(argv[1], &job.count) || job.count == 0 ||
+                   job.count >> 48)){
+    uart1_printf("Error: ARG1 should be a positive number of messages.\n");
+    return 1;
+  }
+
+  // One producer and one consumer, for all core pairs.
+  for(u64 q = 0; q < 2; q++){
+    job.mpsc = q == 1;
+    uart1_printf("%s throughput (Mmsg/s), from row core to column core:\n",
+                 job.mpsc ? "MPSC" : "SPSC");
+    uart1_printf("from\\to");
+    for(u64 c = 0; c < NB_CORES; c++){
+      uart1_printf("\t%u", c);
+    }
+    uart1_printf("\n");
+
+    for(u64 p = 0; p < NB_CORES; p++){
+      if(!smp_is_online(p)) continue;
+      uart1_printf("%u", p);
+      for(u64 c = 0; c < NB_CORES; c++){
+        if(c == p || !smp_is_online(c)){
+          uart1_printf("\t-");
+          continue;
+        }
+        u64 ticks = qbench_run(&job, 1ULL << p, c);
+        if(ticks == 0) return 1;
+        qbench_print_rate(&job, ticks);
+      }
+      uart1_printf("\n");
+    }
+  }
+
+  // All other cores producing into the MPSC queue, consumed by this core.
+  u64 self = smp_core_id();
+  u64 producers = 0;
+  job.nb_producers = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(core == self || !smp_is_online(core)) continue;
+    producers |= 1ULL << core;
+    job.nb_producers++;
+  }
+  if(job.nb_producers > 1){
+    job.mpsc = true;
+    uart1_printf("MPSC fan-in (Mmsg/s), %u producers to core %u:",
+                 job.nb_producers, self);
+    u64 ticks = qbench_run(&job, producers, self);
+    if(ticks == 0) return 1;
+    qbench_print_rate(&job, ticks);
+    uart1_printf("\n");
+  }
+
+  uart1_printf("(A \"!\" marks measurements with corrupted messages.)\n");
+  return 0;
+}
+
+// Default number of increments done by each core in "pcpubench".
+#define PCPUBENCH_DEFAULT_ITERS 0x100000
+
+// Counter variants measured by "pcpubench".
+#define PCPUBENCH_SHARED 0 // A single counter, with atomic increments.
+#define PCPUBENCH_PACKED 1 // An array of per-core counters (false sharing).
+#define PCPUBENCH_PERCPU 2 // Per-core variables (see "kernel/percpu.h").
+
+static const char *pcpubench_names[] = {
+  "shared atomic counter   ",
+  "per-core array (packed) ",
+  "per-core variables      "
+};
+
+static volatile u64 pcpubench_shared;
+static volatile u64 pcpubench_packed[NB_CORES];
+static DEFINE_PER_CPU(volatile u64, pcpubench_counter);
+
+// Parameters of a "pcpubench" measurement.
+typedef struct {
+  u64 variant; // One of the PCPUBENCH_* constants.
+  u64 iters;   // Number of increments for each core.
+} pcpubench_job;
+
+static void pcpubench_run(void *arg){
+  pcpubench_job *job = (pcpubench_job *) arg;
+  u64 core = smp_core_id();
+
+  switch(job->variant){
+    case PCPUBENCH_SHARED:
+      for(u64 i = 0; i < job->iters; i++){
+        atomic_fetch_add(&pcpubench_shared, 1);
+      }
+      break;
+    case PCPUBENCH_PACKED:
+      for(u64 i = 0; i < job->iters; i++){
+        pcpubench_packed[core]++;
+      }
+      break;
+    case PCPUBENCH_PERCPU:
+      for(u64 i = 0; i < job->iters; i++){
+        (*this_cpu_ptr(pcpubench_counter))++;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Run fn(arg) on all the cores of the mask (bit i for core i, the caller may be
+// included), and wait for all of them to be done. Returns false if some core
+// was offline or busy (fn(arg) is then not run on that core).
+static bool run_on_cores(u64 mask, smp_fn fn, void *arg){
+  u64 self = smp_core_id();
+  u64 started = 0;
+  bool ok = true;
+
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(core == self || !((mask >> core) & 1)) continue;
+    if(smp_run_on(core, fn, arg)){
+      started |= 1ULL << core;
+    } else {
+      ok = false;
+    }
+  }
+  if((mask >> self) & 1) fn(arg);
+  for(u64 core = 0; core < NB_CORES; core++){
+    if((started >> core) & 1) smp_wait(core);
+  }
+
+  return ok;
+}
+
+// Mask of the online cores.
+static u64 online_cores(){
+  u64 mask = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(smp_is_online(core)) mask |= 1ULL << core;
+  }
+  return mask;
+}
+
+int pcpubench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  pcpubench_job job = { .variant = 0, .iters = PCPUBENCH_DEFAULT_ITERS };
+  if(argc == 2 && (!parse_u64(argv[1], &job.iters) || job.iters == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of increments.\n");
+    return 1;
+  }
+
+  u64 nb_cores = smp_nb_online();
+  uart1_printf("%u increments on each of %u core(s):\n", job.iters, nb_cores);
+
+  for(u64 v = PCPUBENCH_SHARED; v <= PCPUBENCH_PERCPU; v++){
+    job.variant = v;
+
+    pcpubench_shared = 0;
+    for(u64 core = 0; core < NB_CORES; core++){
+      pcpubench_packed[core] = 0;
+      *per_cpu_ptr(pcpubench_counter, core) = 0;
+    }
+
+    u64 start = counter_ticks();
+    if(!run_on_cores(online_cores(), pcpubench_run, &job)){
+      uart1_printf("Error: some core is busy.\n");
+      return 1;
+    }
+    u64 us = ticks_to_us(counter_ticks() - start);
+    if(us == 0) us = 1;
+
+    u64 total = pcpubench_shared;
+    for(u64 core = 0; core < NB_CORES; core++){
+      total += pcpubench_packed[core] + *per_cpu_ptr(pcpubench_counter, core);
+    }
+
+    u64 rate = job.iters * nb_cores * 100 / us; // In hundredths.
+    uart1_printf("%s %u us, %u.%u%u Minc/s%s\n", pcpubench_names[v], us,
+                 rate / 100, (rate / 10) % 10, rate % 10,
+                 total == job.iters * nb_cores ? "" : " (WRONG TOTAL)");
+  }
+
+  return 0;
+}
+
+// Number of lines printed by "console bench".
+#define CONSOLE_BENCH_LINES 32
+
+// Measure the cost of "uart1_printf" for the caller, in the current mode.
+static void console_bench(){
+  u64 min = UINT64_MAX;
+  u64 max = 0;
+  u64 total = 0;
+
+  for(u64 i = 0; i < CONSOLE_BENCH_LINES; i++){
+    u64 start = pmu_cycles();
+    uart1_printf("console bench: line %u of %u.\n", i + 1,
+                 (u64) CONSOLE_BENCH_LINES);
+    u64 cycles = pmu_cycles() - start;
+
+    total += cycles;
+    if(cycles < min) min = cycles;
+    if(cycles > max) max = cycles;
+  }
+
+  uart1_printf("uart1_printf: %u cycles on average (min %u, max %u).\n",
+               total / CONSOLE_BENCH_LINES, min, max);
+}
+
+int console(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  if(argc == 2){
+    u64 core;
+    if(strcmp(argv[1], "off") == 0){
+      console_stop();
+    } else if(strcmp(argv[1], "bench") == 0){
+      console_bench();
+      return 0;
+    } else if(parse_u64(argv[1], &core)){
+      if(console_enabled() || core == 0 || !console_start(core)){
+        uart1_printf("Error: cannot start the console on core %u.\n", core);
+        return 1;
+      }
+    } else {
+      uart1_printf("Error: ARG1 should be a core, \"off\" or \"bench\".\n");
+      return 1;
+    }
+  }
+
+  if(console_enabled()){
+    uart1_printf("Console core: %u (%u records written, %u waits).\n",
+                 console_core(), console_nb_records(), console_nb_full());
+  } else {
+    uart1_printf("Console core: none (direct UART output).\n");
+  }
+  return 0;
+}
+
+// Default size (in bytes) of the buffers copied by "membench", and maximum.
+#define MEMBENCH_DEFAULT_SIZE 0x100000
+#define MEMBENCH_MAX_SIZE     0x1000000
+
+// Number of copies done by "membench".
+#define MEMBENCH_REPS 4
+
+int membench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 size = MEMBENCH_DEFAULT_SIZE;
+  if(argc == 2 && (!parse_u64(argv[1], &size) || size < 8 ||
+                   size > MEMBENCH_MAX_SIZE)){
+    uart1_printf("Error: ARG1 should be a size between 8 and %u bytes.\n",
+                 (u64) MEMBENCH_MAX_SIZE);
+    return 1;
+  }
+  size &= ~7ULL;
+
+  // Each core uses its own source and destination buffers (so that the command
+  // can run on several cores at once, see "smp").
+  u64 *src = (u64 *) (scratch_memory() + 2 * MEMBENCH_MAX_SIZE * smp_core_id());
+  u64 *dst = (u64 *) ((u8 *) src + MEMBENCH_MAX_SIZE);
+  u64 words = size / 8;
+  for(u64 i = 0; i < words; i++){
+    src[i] = i;
+  }
+
+  u64 start = counter_ticks();
+  for(u64 r = 0; r < MEMBENCH_REPS; r++){
+    for(u64 i = 0; i < words; i++){
+      dst[i] = src[i];
+    }
+  }
+  u64 time = counter_ticks() - start;
+  if(time == 0) time = 1;
+
+  // Bytes read and written.
+  u64 bytes = 2 * size * MEMBENCH_REPS;
+  cmd_report_work(bytes);
+  uart1_printf("Core %u: copied %u bytes %u times, %u MB/s.\n", smp_core_id(),
+               size, (u64) MEMBENCH_REPS,
+               bytes * read_cntfrq_el0() / time / 1000000);
+  return 0;
+}
+
+// Parse a non-empty set of integers smaller than limit (at most 64), given as
+// a comma-separated list of integers or ranges (e.g., "0-2", "1,3" or "0,2-3").
+static bool parse_set(char *s, u64 limit, u64 *mask){
+  // Note: "strtou64" sets end to NULL when it reaches the end of the string.
+  *mask = 0;
+  char *end = s;
+  while(end){
+    u64 first = strtou64(s, &end, 10);
+    if(end == s) return false;
+    u64 last = first;
+    if(end && *end == '-'){
+      s = end + 1;
+      last = strtou64(s, &end, 10);
+      if(end == s) return false;
+    }
+    if(end && *end != ',') return false;
+    if(end) s = end + 1;
+
+    if(first > last || last >= limit) return false;
+    for(u64 i = first; i <= last; i++){
+      *mask |= 1ULL << i;
+    }
+  }
+
+  return *mask != 0;
+}
+
+// Parse a set of cores, given as for "parse_set", or as "all" (online cores).
+static bool parse_core_set(char *s, u64 *mask){
+  if(strcmp(s, "all") == 0){
+    *mask = online_cores();
+    return true;
+  }
+  return parse_set(s, NB_CORES, mask);
+}
+
+// A command run by "smp", with its results for each core.
+typedef struct {
+  cmd_descr *cmd;
+  size_t argc;
+  char **argv;
+  int res[NB_CORES];
+  u64 cycles[NB_CORES];
+  u64 work[NB_CORES];
+} smp_job;
+
+static void smp_job_run(void *arg){
+  smp_job *job = (smp_job *) arg;
+  u64 core = smp_core_id();
+
+  this_cpu_write(cmd_work, 0);
+  u64 start = pmu_cycles();
+  job->res[core] = (job->cmd->func)(job->argc, job->argv);
+  job->cycles[core] = pmu_cycles() - start;
+  job->work[core] = this_cpu_read(cmd_work);
+}
+
+// Run the job on the cores of the mask, and return the total work done (or
+// the number of runs, if the command reports no work) per second.
+static u64 smp_job_throughput(smp_job *job, u64 mask, bool *ok){
+  for(u64 core = 0; core < NB_CORES; core++){
+    job->res[core] = 0;
+    job->cycles[core] = 0;
+    job->work[core] = 0;
+  }
+
+  u64 start = counter_ticks();
+  *ok = run_on_cores(mask, smp_job_run, job);
+  u64 us = ticks_to_us(counter_ticks() - start);
+  if(us == 0) us = 1;
+
+  u64 work = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(!((mask >> core) & 1)) continue;
+    work += job->work[core] ? job->work[core] : 1;
+    if(job->res[core] != 0) *ok = false;
+  }
+  return work * 1000000 / us;
+}
+
+int smp(size_t argc, char **argv){
+  if(argc < 3){
+    uart1_printf("Error: \"%s\" expects a core set and a command.\n", argv[0]);
+    return 1;
+  }
+
+  u64 mask;
+  if(!parse_core_set(argv[1], &mask) || (mask & ~online_cores())){
+    uart1_printf("Error: ARG1 should be a set of online cores.\n");
+    return 1;
+  }
+
+  smp_job job;
+  job.cmd = cmd_find(argv[2]);
+  job.argc = argc - 2;
+  job.argv = argv + 2;
+  if(job.cmd == NULL || job.cmd->func == smp){
+    uart1_printf("Error: invalid command \"%s\".\n", argv[2]);
+    return 1;
+  }
+
+  u64 nb = 0;
+  u64 first = NB_CORES;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(!((mask >> core) & 1)) continue;
+    if(first == NB_CORES) first = core;
+    nb++;
+  }
+
+  // Reference: the first core alone.
+  bool ok;
+  u64 ref = smp_job_throughput(&job, 1ULL << first, &ok);
+  if(!ok){
+    uart1_printf("Error: the command failed on core %u.\n", first);
+    return 1;
+  }
+
+  u64 all = ref;
+  if(nb > 1){
+    all = smp_job_throughput(&job, mask, &ok);
+  }
+
+  bool reported = job.work[first] != 0;
+  uart1_printf("core\tstatus\tcycles\t\twork\n");
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(!((mask >> core) & 1)) continue;
+    uart1_printf("%u\t%i\t%u\t%u\n", core, job.res[core], job.cycles[core],
+                 job.work[core]);
+  }
+
+  const char *unit = reported ? "units" : "runs";
+  uart1_printf("1 core(s): %u %s/s.\n", ref, unit);
+  if(nb > 1){
+    u64 speedup = all * 100 / (ref ? ref : 1);  // In hundredths.
+    uart1_printf("%u core(s): %u %s/s, speedup %u.%u%ux, efficiency %u%%.\n",
+                 nb, all, unit, speedup / 100, (speedup / 10) % 10,
+                 speedup % 10, speedup / nb);
+  }
+
+  if(!ok){
+    uart1_printf("Error: the command failed on some core(s).\n");
+    return 1;
+  }
+  return 0;
+}
+
+// Events counted by the "perf" command (more than the 6 counters of the
+// Cortex-A53, so they are multiplexed), and their names.
+#define PERF_NB_EVENTS 8
+
+static const u64 perf_events[PERF_NB_EVENTS] = {
+  PMU_EVENT_INST_RETIRED,
+  PMU_EVENT_L1I_CACHE_REFILL,
+  PMU_EVENT_L1D_CACHE,
+  PMU_EVENT_L1D_CACHE_REFILL,
+  PMU_EVENT_L2D_CACHE,
+  PMU_EVENT_L2D_CACHE_REFILL,
+  PMU_EVENT_BR_PRED,
+  PMU_EVENT_BR_MIS_PRED
+};
+
+static const char *perf_names[PERF_NB_EVENTS] = {
+  "instructions",
+  "L1I misses",
+  "L1D accesses",
+  "L1D misses",
+  "L2 accesses",
+  "L2 misses",
+  "branches",
+  "mispredicts"
+};
+
+// Print num / den with two decimals (as a percentage if percent is set).
+static void perf_print_ratio(const char *name, u64 num, u64 den, bool percent){
+  if(den == 0) return;
+  u64 r = num * (percent ? 10000 : 100) / den; // In hundredths.
+  uart1_printf("%s: %u.%u%u%s\n", name, r / 100, (r / 10) % 10, r % 10,
+               percent ? "%" : "");
+}
+
+int perf(size_t argc, char **argv){
+  if(argc < 2){
+    uart1_printf("Error: \"%s\" expects a command.\n", argv[0]);
+    return 1;
+  }
+
+  cmd_descr *cmd = cmd_find(argv[1]);
+  if(cmd == NULL || cmd->func == perf){
+    uart1_printf("Error: invalid command \"%s\".\n", argv[1]);
+    return 1;
+  }
+
+  perf_session s;
+  if(!perf_start(&s, perf_events, PERF_NB_EVENTS)){
+    uart1_printf("Error: cannot count events (PMU busy on this core).\n");
+    return 1;
+  }
+  int res = cmd->func(argc - 1, argv + 1);
+  perf_stop(&s);
+
+  uart1_printf("\n\"%s\" returned %i after %u us on core %u.\n", argv[1], res,
+               ticks_to_us(s.total_ticks), smp_core_id());
+  uart1_printf("%u events on %u counters (%u groups, %u rotations).\n",
+               s.nb_events, s.nb_counters, perf_nb_groups(&s), s.nb_rotations);
+  uart1_printf("cycles\t\t%u\n", s.cycles);
+
+  // Names have at least 8 characters (a single tab aligns the counts).
+  u64 scaled[PERF_NB_EVENTS];
+  u64 total = s.total_ticks ? s.total_ticks : 1;
+  for(u64 i = 0; i < PERF_NB_EVENTS; i++){
+    scaled[i] = perf_scaled(&s, i);
+    uart1_printf("%s\t%u (counted %u%% of the time)\n", perf_names[i],
+                 scaled[i], s.ticks[i] * 100 / total);
+  }
+
+  perf_print_ratio("IPC", scaled[0], s.cycles, false);
+  perf_print_ratio("L1I miss rate (per instruction)", scaled[1], scaled[0],
+                   true);
+  perf_print_ratio("L1D miss rate", scaled[3], scaled[2], true);
+  perf_print_ratio("L2 miss rate", scaled[5], scaled[4], true);
+  perf_print_ratio("Branch mispredict rate", scaled[7], scaled[6], true);
+  return res;
+}
+
+int irqstat(size_t argc, char **argv){
+  if(argc == 2 && strcmp(argv[1], "reset") == 0){
+    irq_reset_stats();
+    return 0;
+  }
+  if(argc != 1){
+    uart1_printf("Error: \"%s\" expects no argument, or \"reset\".\n", argv[0]);
+    return 1;
+  }
+
+  uart1_printf("IRQ\tNAME\tCORE\tCOUNT\tAVG(ns)\tMAX(ns)\tLAT(ns)\tMAXLAT(ns)\n");
+  for(u64 irq = 0; irq < NB_IRQS; irq++){
+    const char *name = irq_name(irq);
+    if(name == NULL) continue;
+
+    for(u64 core = 0; core < NB_CORES; core++){
+      irq_stats s;
+      irq_get_stats(irq, core, &s);
+      if(s.count == 0) continue;
+
+      uart1_printf("%u\t%s\t%u\t%u\t%u\t%u\t", irq, name, core, s.count,
+                   ticks_to_ns(s.time_total / s.count),
+                   ticks_to_ns(s.time_max));
+      if(s.lat_count == 0){
+        uart1_printf("-\t-\n");
+      } else {
+        uart1_printf("%u\t%u\n", ticks_to_ns(s.lat_total / s.lat_count),
+                     ticks_to_ns(s.lat_max));
+      }
+    }
+  }
+
+  for(u64 core = 0; core < NB_CORES; core++){
+    u64 nb = irq_nb_spurious(core);
+    if(nb) uart1_printf("Core %u: %u spurious IRQ(s).\n", core, nb);
+  }
+
+  return 0;
+}
+
+// Default number of increments done by each core in "hvcstress".
+#define HVCSTRESS_DEFAULT_OPS 0x10000
+
+// Work of each core in "hvcstress": half of the increments are direct
+// hypercalls, and the other half go through the ring of the core (in batches
+// of the size of the ring).
+static void hvcstress_run(void *arg){
+  u64 n = *((u64 *) arg);
+  hvc_ring *r = &(hvcbatch_rings[smp_core_id()]);
+  if(!hvc_ring_setup(r)) return;
+
+  for(u64 i = 0; i < n / 2; i++){
+    hvc_call(HVC_COUNTER_INC, 0, 0, 0);
+  }
+  for(u64 done = n / 2; done < n; done += HVC_RING_SIZE){
+    u64 k = n - done < HVC_RING_SIZE ? n - done : HVC_RING_SIZE;
+    for(u64 i = 0; i < k; i++){
+      hvc_ring_push(r, HVC_COUNTER_INC, 0, 0, 0);
+    }
+    hvc_ring_submit();
+  }
+}
+
+int hvcstress(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 n = HVCSTRESS_DEFAULT_OPS;
+  if(argc == 2 && (!parse_u64(argv[1], &n) || n == 0)){
+    uart1_printf("Error: ARG1 should be a positive number of increments.\n");
+    return 1;
+  }
+
+  u64 mask = online_cores();
+  u64 cores = __builtin_popcountll(mask);
+  i64 before = hvc_call(HVC_COUNTER_GET, 0, 0, 0);
+
+  u64 start = counter_ticks();
+  bool ok = run_on_cores(mask, hvcstress_run, &n);
+  u64 ticks = counter_ticks() - start;
+  if(ticks == 0) ticks = 1;
+
+  u64 expected = cores * n;
+  u64 got = (u64) (hvc_call(HVC_COUNTER_GET, 0, 0, 0) - before);
+  uart1_printf("%u cores, %u increments each: %u ns, %u increments/s.\n",
+               cores, n, ticks_to_ns(ticks),
+               expected * read_cntfrq_el0() / ticks);
+  if(!ok || got != expected){
+    uart1_printf("Error: %u increments counted, %u expected.\n", got, expected);
+    return 1;
+  }
+  uart1_printf("Counter total verified (%u increments).\n", got);
+  return 0;
+}
+
+// Profiling of EL1 from EL2 (see "kernel/prof.h"). The histograms of all the
+// cores are merged in scratch memory, and the hottest PCs are printed as lines
+// "0xADDR COUNT PERCENT", which the "symbolize" target of the Makefile reads.
+#define PROF_DEFAULT_PERIOD 100000
+#define PROF_DEFAULT_TOP    20
+
+// Result of the hypercall of each core, or PROF_NOT_RUN if the core was busy
+// (the hypercall was then not issued).
+#define PROF_NOT_RUN 1
+static i64 prof_results[NB_CORES];
+
+static void prof_start_core(void *arg){
+  u64 period = *((u64 *) arg);
+  prof_results[smp_core_id()] = hvc_call(HVC_PROF_START, period, 0, 0);
+}
+
+static void prof_stop_core(void *arg){
+  UNUSED(arg);
+  prof_results[smp_core_id()] = hvc_call(HVC_PROF_STOP, 0, 0, 0);
+}
+
+// Shell sort of the n samples, by increasing PC, or by decreasing count.
+static void prof_sort(prof_sample *samples, u64 n, bool by_count){
+  u64 gap = 1;
+  while(gap < n / 3) gap = 3 * gap + 1;
+
+  for(; gap > 0; gap /= 3){
+    for(u64 i = gap; i < n; i++){
+      prof_sample v = samples[i];
+      u64 j = i;
+      for(; j >= gap; j -= gap){
+        prof_sample *p = &(samples[j - gap]);
+        if(by_count ? p->count >= v.count : p->pc <= v.pc) break;
+        samples[j] = *p;
+      }
+      samples[j] = v;
+    }
+  }
+}
+
+static int prof_show(u64 top){
+  prof_sample *samples = (prof_sample *) scratch_memory();
+  u64 n = 0;
+  u64 total = 0;
+  u64 dropped = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    u64 res[3];
+    i64 k = hvc_call_res(HVC_PROF_READ, core, (u64) (samples + n), PROF_SLOTS,
+                         res);
+    if(k < 0){
+      uart1_printf("Error: cannot read the samples of core %u.\n", core);
+      return 1;
+    }
+    n += (u64) k;
+    total += res[0];
+    dropped += res[1];
+  }
+
+  // Merge the entries of the different cores for the same PC.
+  prof_sort(samples, n, false);
+  u64 m = 0;
+  for(u64 i = 0; i < n; i++){
+    if(m > 0 && samples[m - 1].pc == samples[i].pc){
+      samples[m - 1].count += samples[i].count;
+    } else {
+      samples[m++] = samples[i];
+    }
+  }
+  prof_sort(samples, m, true);
+
+  uart1_printf("%u samples (%u dropped), %u distinct PCs.\n", total, dropped,
+               m);
+  if(total == 0) return 0;
+  for(u64 i = 0; i < m && i < top; i++){
+    uart1_printf("0x%w %u %u%%\n", samples[i].pc, samples[i].count,
+                 samples[i].count * 100 / total);
+  }
+  return 0;
+}
+
+int prof(size_t argc, char **argv){
+  const char *op = argc >= 2 ? argv[1] : "show";
+  bool start = strcmp(op, "start") == 0;
+  bool stop = strcmp(op, "stop") == 0;
+  bool show = strcmp(op, "show") == 0;
+  if(argc > 3 || !(start || stop || show) || (stop && argc == 3)){
+    uart1_printf("Error: usage is \"%s [start [PERIOD]|stop|show [N]]\".\n",
+                 argv[0]);
+    return 1;
+  }
+
+  u64 arg = start ? PROF_DEFAULT_PERIOD : PROF_DEFAULT_TOP;
+  if(argc == 3 && !parse_u64(argv[2], &arg)){
+    uart1_printf("Error: ARG2 should be a number.\n");
+    return 1;
+  }
+  if(show) return prof_show(arg);
+
+  u64 online = online_cores();
+  for(u64 core = 0; core < NB_CORES; core++){
+    prof_results[core] = (online >> core) & 1 ? PROF_NOT_RUN : 0;
+  }
+  run_on_cores(online, start ? prof_start_core : prof_stop_core, &arg);
+
+  // Only starting can fail, when the period is invalid.
+  bool ok = true;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(prof_results[core] == PROF_NOT_RUN){
+      uart1_printf("Error: core %u is busy (profiling was not %s on it).\n",
+                   core, start ? "started" : "stopped");
+      ok = false;
+    } else if(prof_results[core] != 0){
+      uart1_printf("Error: cannot start profiling on core %u (the period "
+                   "should be between %u and %u cycles).\n", core,
+                   (u64) PROF_MIN_PERIOD, PROF_MAX_PERIOD);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
+
+// Tracing of the MMIO accesses of EL1 (see "kernel/mmiotrace.h"). The tables
+// of all the cores are merged in scratch memory. Calling sites are printed as
+// lines "0xPC COUNT ...", which the "symbolize" target of the Makefile reads.
+#define MMIO_DEFAULT_TOP 10
+
+// Shell sort of the n sites, by increasing register and PC, or by decreasing
+// number of accesses.
+static void mmio_sort(mmiotrace_site *sites, u64 n, bool by_count){
+  u64 gap = 1;
+  while(gap < n / 3) gap = 3 * gap + 1;
+
+  for(; gap > 0; gap /= 3){
+    for(u64 i = gap; i < n; i++){
+      mmiotrace_site v = sites[i];
+      u64 j = i;
+      for(; j >= gap; j -= gap){
+        mmiotrace_site *p = &(sites[j - gap]);
+        bool ordered = by_count
+          ? p->reads + p->writes >= v.reads + v.writes
+          : p->addr < v.addr || (p->addr == v.addr && p->pc <= v.pc);
+        if(ordered) break;
+        sites[j] = *p;
+      }
+      sites[j] = v;
+    }
+  }
+}
+
+// Merge the n sorted sites with the same register (and the same PC, unless
+// by_register is set) into the first entries, and return their number.
+static u64 mmio_merge(mmiotrace_site *sites, u64 n, bool by_register){
+  u64 m = 0;
+  for(u64 i = 0; i < n; i++){
+    mmiotrace_site *p = m > 0 ? &(sites[m - 1]) : NULL;
+    if(p && p->addr == sites[i].addr && (by_register || p->pc == sites[i].pc)){
+      p->reads += sites[i].reads;
+      p->writes += sites[i].writes;
+    } else {
+      sites[m++] = sites[i];
+    }
+  }
+  return m;
+}
+
+static int mmio_show(u64 top){
+  mmiotrace_site *sites = (mmiotrace_site *) scratch_memory();
+  u64 n = 0;
+  u64 traps = 0;
+  u64 dropped = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    u64 res[3];
+    i64 k = hvc_call_res(HVC_MMIO_SITES, core, (u64) (sites + n),
+                         MMIOTRACE_SITES, res);
+    if(k < 0){
+      uart1_printf("Error: cannot read the sites of core %u.\n", core);
+      return 1;
+    }
+    n += (u64) k;
+    traps += res[0];
+    dropped += res[1];
+    if(res[2] != 0){
+      uart1_printf("Tracing stopped on core %u by the access at 0x%w.\n",
+                   core, res[2]);
+    }
+  }
+  uart1_printf("%u traced accesses (%u not in the tables).\n", traps, dropped);
+
+  // Sites, and then registers (in a copy placed after the sites).
+  mmio_sort(sites, n, false);
+  n = mmio_merge(sites, n, false);
+  mmiotrace_site *regs = sites + n;
+  for(u64 i = 0; i < n; i++) regs[i] = sites[i];
+  u64 nb_regs = mmio_merge(regs, n, true);
+  mmio_sort(sites, n, true);
+  mmio_sort(regs, nb_regs, true);
+
+  uart1_printf("Registers (%u):\n", nb_regs);
+  for(u64 i = 0; i < nb_regs && i < top; i++){
+    uart1_printf("  0x%w: %u reads, %u writes\n", regs[i].addr,
+                 regs[i].reads, regs[i].writes);
+  }
+  uart1_printf("Calling sites (%u):\n", n);
+  for(u64 i = 0; i < n && i < top; i++){
+    uart1_printf("0x%w %u 0x%w (%u reads, %u writes)\n", sites[i].pc,
+                 sites[i].reads + sites[i].writes, sites[i].addr,
+                 sites[i].reads, sites[i].writes);
+  }
+  return 0;
+}
+
+static int mmio_log(u64 max){
+  mmiotrace_access *log = (mmiotrace_access *) scratch_memory();
+  if(max > MMIOTRACE_LOG) max = MMIOTRACE_LOG;
+  for(u64 core = 0; core < NB_CORES; core++){
+    i64 n = hvc_call(HVC_MMIO_LOG, core, (u64) log, max);
+    if(n < 0){
+      uart1_printf("Error: cannot read the log of core %u.\n", core);
+      return 1;
+    }
+    for(u64 i = 0; i < (u64) n; i++){
+      mmiotrace_access *a = &(log[i]);
+      uart1_printf("core %u: %s%u 0x%w = 0x%w at 0x%w\n", core,
+                   a->size & MMIOTRACE_WRITE ? "W" : "R",
+                   8 * (a->size & ~MMIOTRACE_WRITE), a->addr, a->value, a->pc);
+    }
+  }
+  return 0;
+}
+
+int mmio(size_t argc, char **argv){
+  const char *op = argc >= 2 ? argv[1] : "show";
+  bool start = strcmp(op, "start") == 0;
+  bool stop = strcmp(op, "stop") == 0;
+  bool show = strcmp(op, "show") == 0;
+  bool log = strcmp(op, "log") == 0;
+  if(argc > 3 || !(start || stop || show || log) ||
+     ((start || stop) && argc == 3)){
+    uart1_printf("Error: usage is \"%s [start|stop|show [N]|log [N]]\".\n",
+                 argv[0]);
+    return 1;
+  }
+
+  u64 arg = log ? MMIOTRACE_LOG : MMIO_DEFAULT_TOP;
+  if(argc == 3 && !parse_u64(argv[2], &arg)){
+    uart1_printf("Error: ARG2 should be a number.\n");
+    return 1;
+  }
+  if(show) return mmio_show(arg);
+  if(log) return mmio_log(arg);
+
+  if(hvc_call(HVC_MMIO_CTL, start ? MMIOTRACE_START : MMIOTRACE_STOP, 0, 0)){
+    uart1_printf("Error: cannot %s tracing.\n", op);
+    return 1;
+  }
+  return 0;
+}
+
+// Default number of events streamed by "gpiocap", and time without event (in
+// us) after which it stops.
+#define GPIOCAP_DEFAULT_COUNT 64
+#define GPIOCAP_IDLE_US       10000000
+
+// Polling period (in us) of the ring of captured events.
+#define GPIOCAP_POLL_US 1000
+
+int gpiocap(size_t argc, char **argv){
+  u64 pins;
+  if(argc < 2 || !parse_set(argv[1], GPIOCAP_NB_PINS, &pins)){
+    uart1_printf("Error: usage is \"%s PINS [rising | falling | both] "
+                 "[async] [COUNT]\".\n", argv[0]);
+    return 1;
+  }
+
+  u64 flags = GPIOCAP_RISING | GPIOCAP_FALLING;
+  u64 count = GPIOCAP_DEFAULT_COUNT;
+  for(size_t i = 2; i < argc; i++){
+    if(strcmp(argv[i], "rising") == 0){
+      flags = (flags & GPIOCAP_ASYNC) | GPIOCAP_RISING;
+    } else if(strcmp(argv[i], "falling") == 0){
+      flags = (flags & GPIOCAP_ASYNC) | GPIOCAP_FALLING;
+    } else if(strcmp(argv[i], "both") == 0){
+      flags |= GPIOCAP_RISING | GPIOCAP_FALLING;
+    } else if(strcmp(argv[i], "async") == 0){
+      flags |= GPIOCAP_ASYNC;
+    } else if(!parse_u64(argv[i], &count) || count == 0){
+      uart1_printf("Error: invalid argument \"%s\".\n", argv[i]);
+      return 1;
+    }
+  }
+
+  gpiocap_reset();
+  for(u64 pin = 0; pin < GPIOCAP_NB_PINS; pin++){
+    if(((pins >> pin) & 1) && !gpiocap_enable(pin, flags)){
+      uart1_printf("Error: cannot capture pin %u.\n", pin);
+      gpiocap_reset();
+      return 1;
+    }
+  }
+
+  // Stream the events (times are relative to the first event).
+  u64 events = gpiocap_nb_events();
+  u64 dropped = gpiocap_nb_dropped();
+  uart1_printf("TIME(ns)\tDELTA(ns)\tPIN\tEDGE\n");
+  u64 first = 0;
+  u64 last = 0;
+  u64 n = 0;
+  u64 idle = 0;
+  while(n < count && idle < GPIOCAP_IDLE_US){
+    gpiocap_event e;
+    if(!gpiocap_pop(&e)){
+      thread_sleep_us(GPIOCAP_POLL_US);
+      idle += GPIOCAP_POLL_US;
+      continue;
+    }
+    idle = 0;
+
+    if(n == 0) first = last = e.time;
+    uart1_printf("%u\t\t%u\t\t%u\t%s\n", ticks_to_ns(e.time - first),
+                 ticks_to_ns(e.time - last), (u64) e.pin,
+                 e.edge == GPIOCAP_RISING ? "rising" : "falling");
+    last = e.time;
+    n++;
+  }
+  gpiocap_reset();
+
+  uart1_printf("%u events captured, %u dropped (ring full).\n",
+               gpiocap_nb_events() - events, gpiocap_nb_dropped() - dropped);
+  return 0;
+}
+
+// Default number of toggles done by "gpiobench" (for each measurement), and
+// default set of pins.
+#define GPIOBENCH_DEFAULT_TOGGLES 100000
+#define GPIOBENCH_DEFAULT_PINS    "21"
+
+// Print a toggle rate (full periods per second) for a "gpiobench" measurement.
+static void gpiobench_report(const char *method, u64 toggles, u64 ticks){
+  if(ticks == 0) ticks = 1;
+  u64 rate = toggles * read_cntfrq_el0() / ticks;
+  uart1_printf("%s: %u ns per period, %u periods/s\n", method,
+               ticks_to_ns(ticks) / toggles, rate);
+}
+
+int gpiobench(size_t argc, char **argv){
+  if(argc > 3){
+    uart1_printf("Error: usage is \"%s [PINS] [TOGGLES]\".\n", argv[0]);
+    return 1;
+  }
+
+  char pins_default[] = GPIOBENCH_DEFAULT_PINS;
+  u64 pins;
+  if(!parse_set(argc >= 2 ? argv[1] : pins_default, GPIO_NB_PINS, &pins) ||
+     (pins & ((1ULL << 14) | (1ULL << 15)))){
+    uart1_printf("Error: ARG1 should be a set of pins (excluding the UART "
+                 "pins 14 and 15).\n");
+    return 1;
+  }
+
+  u64 toggles = GPIOBENCH_DEFAULT_TOGGLES;
+  if(argc == 3 && (!parse_u64(argv[2], &toggles) || toggles == 0)){
+    uart1_printf("Error: ARG2 should be a positive number of toggles.\n");
+    return 1;
+  }
+
+  // Save the functions of the pins, and make them outputs.
+  u32 saved[GPIO_NB_PINS];
+  for(u64 pin = 0; pin < GPIO_NB_PINS; pin++){
+    if((pins >> pin) & 1) saved[pin] = gpio_get_function(pin);
+  }
+  gpio_set_function_mask(pins, GPFSEL_OUT);
+
+  uart1_printf("Toggling pins 0x%w (%u times), IRQs masked:\n", pins,
+               toggles);
+  u64 flags = irq_save();
+
+  // One write to GPSET / GPCLR per bank for all the pins.
+  u64 start = counter_ticks();
+  for(u64 i = 0; i < toggles; i++){
+    gpio_set(pins);
+    gpio_clear(pins);
+  }
+  u64 masked = counter_ticks() - start;
+
+  // One write per pin and per edge.
+  start = counter_ticks();
+  for(u64 i = 0; i < toggles; i++){
+    for(u64 pin = 0; pin < GPIO_NB_PINS; pin++){
+      if((pins >> pin) & 1) gpio_set(1ULL << pin);
+    }
+    for(u64 pin = 0; pin < GPIO_NB_PINS; pin++){
+      if((pins >> pin) & 1) gpio_clear(1ULL << pin);
+    }
+  }
+  u64 per_pin = counter_ticks() - start;
+
+  // Read-modify-write of the function select registers (input / output), as
+  // done without the cached API.
+  start = counter_ticks();
+  for(u64 i = 0; i < toggles; i++){
+    for(u64 pin = 0; pin < GPIO_NB_PINS; pin++){
+      if(!((pins >> pin) & 1)) continue;
+      volatile u32 *fsel = GPFSEL0 + pin / 10;
+      u32 shift = 3 * (pin % 10);
+      *fsel = (*fsel & ~(MASK_U32(0, 3) << shift)) | (GPFSEL_IN << shift);
+      *fsel = (*fsel & ~(MASK_U32(0, 3) << shift)) | (GPFSEL_OUT << shift);
+    }
+  }
+  u64 fsel_rmw = counter_ticks() - start;
+
+  // The same, with the cached API.
+  start = counter_ticks();
+  for(u64 i = 0; i < toggles; i++){
+    gpio_set_function_mask(pins, GPFSEL_IN);
+    gpio_set_function_mask(pins, GPFSEL_OUT);
+  }
+  u64 fsel_cached = counter_ticks() - start;
+
+  irq_restore(flags);
+
+  gpiobench_report("gpio_set / gpio_clear (masks)", toggles, masked);
+  gpiobench_report("gpio_set / gpio_clear (per pin)", toggles, per_pin);
+  gpiobench_report("GPFSEL read-modify-write", toggles, fsel_rmw);
+  gpiobench_report("gpio_set_function_mask", toggles, fsel_cached);
+
+  // Restore the functions of the pins.
+  for(u64 pin = 0; pin < GPIO_NB_PINS; pin++){
+    if((pins >> pin) & 1) gpio_set_function(pin, saved[pin]);
+  }
+  return 0;
+}
+
+// Default number of samples taken by "irqbench" (for each configuration), and
+// maximum.
+#define IRQBENCH_DEFAULT_SAMPLES 1000
+#define IRQBENCH_MAX_SAMPLES     10000
+
+// Range of the (random) delays before the deadlines of "irqbench" (in us), and
+// time after which a missing interrupt is reported.
+#define IRQBENCH_MIN_DELAY_US 20
+#define IRQBENCH_MAX_DELAY_US 200
+#define IRQBENCH_TIMEOUT_US   100000
+
+// Size (in bytes) of the buffers copied by the load of "irqbench".
+#define IRQBENCH_LOAD_SIZE 0x100000
+
+// Enable bit of the CNTV_CTL_EL0 register.
+#define CNTV_CTL_ENABLE (1ULL << 0)
+
+// Latencies (in timer ticks) measured by "irqbench", and synchronisation with
+// the handler and with the load on the other cores.
+static u64 irqbench_samples[IRQBENCH_MAX_SAMPLES];
+static volatile u64 irqbench_latency;
+static volatile bool irqbench_fired;
+static volatile u64 irqbench_stop;
+
+// Handler of the virtual timer, which is only used by "irqbench". The latency
+// is the time between the deadline and the entry in the IRQ dispatcher.
+static void irqbench_irq(void *arg){
+  UNUSED(arg);
+  u64 latency = irq_entry_ticks() - read_cntv_cval_el0();
+  write_cntv_ctl_el0(0);
+  irq_record_latency(IRQ_CNTV, latency);
+  irqbench_latency = latency;
+  irqbench_fired = true;
+}
+
+// Load run on the other cores: copy buffers (larger than the L2 cache) until
+// "irqbench_stop" is set.
+static void irqbench_load(void *arg){
+  UNUSED(arg);
+  u8 *buf = scratch_memory() + 2 * IRQBENCH_LOAD_SIZE * smp_core_id();
+  u64 *src = (u64 *) buf;
+  u64 *dst = (u64 *) ((u8 *) src + IRQBENCH_LOAD_SIZE);
+  u64 words = IRQBENCH_LOAD_SIZE / 8;
+
+  while(!atomic_load_acquire(&irqbench_stop)){
+    for(u64 i = 0; i < words; i++){
+      dst[i] = src[i];
+    }
+  }
+}
+
+// Evict the kernel's data from the caches and the TLB of the calling core, so
+// that the next interrupt finds them cold.
+static void irqbench_flush(){
+  dcache_clean_inval_range(__data_start, (u64) (__bss_end - __data_start));
+  asm volatile("tlbi vmalle1; dsb ish; isb" : : : "memory");
+}
+
+// Take n samples of the timer interrupt latency on the calling core, flushing
+// the caches before each of them if cold is set. Returns false on timeout.
+static bool irqbench_sample(u64 n, bool cold){
+  u64 seed = counter_ticks() | 1;
+  u64 range = IRQBENCH_MAX_DELAY_US - IRQBENCH_MIN_DELAY_US;
+  u64 timeout = timer_us_to_ticks(IRQBENCH_TIMEOUT_US);
+
+  for(u64 i = 0; i < n; i++){
+    // Random delays, so that the deadlines are not in phase with other IRQs.
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    u64 delay = IRQBENCH_MIN_DELAY_US + seed % range;
+
+    if(cold) irqbench_flush();
+    irqbench_fired = false;
+    u64 deadline = counter_ticks() + timer_us_to_ticks(delay);
+    write_cntv_cval_el0(deadline);
+    write_cntv_ctl_el0(CNTV_CTL_ENABLE);
+
+    while(!irqbench_fired){
+      if(counter_ticks() > deadline + timeout){
+        write_cntv_ctl_el0(0);
+        return false;
+      }
+    }
+    irqbench_samples[i] = irqbench_latency;
+  }
+
+  return true;
+}
+
+// Sort the n first samples (Shell sort, with gaps 3^k-1 / 2).
+static void irqbench_sort(u64 n){
+  u64 gap = 1;
+  while(gap < n / 3) gap = 3 * gap + 1;
+
+  for(; gap > 0; gap /= 3){
+    for(u64 i = gap; i < n; i++){
+      u64 v = irqbench_samples[i];
+      u64 j = i;
+      for(; j >= gap && irqbench_samples[j - gap] > v; j -= gap){
+        irqbench_samples[j] = irqbench_samples[j - gap];
+      }
+      irqbench_samples[j] = v;
+    }
+  }
+}
+
+// Histogram bucket of a latency (in ns): bucket b > 0 is [2^(b-1), 2^b).
+static u64 irqbench_bucket(u64 ns){
+  return ns == 0 ? 0 : 64 - (u64) __builtin_clzll(ns);
+}
+
+// Print the summary and the log2 histogram (in ns) of the n first samples.
+static void irqbench_report(const char *config, u64 n){
+  irqbench_sort(n);
+  u64 p99 = n * 99 / 100;
+  if(p99 >= n) p99 = n - 1;
+
+  uart1_printf("%s: min %u ns, median %u ns, p99 %u ns, max %u ns\n", config,
+               ticks_to_ns(irqbench_samples[0]),
+               ticks_to_ns(irqbench_samples[n / 2]),
+               ticks_to_ns(irqbench_samples[p99]),
+               ticks_to_ns(irqbench_samples[n - 1]));
+
+  // Samples are sorted, so each bucket is a contiguous range.
+  u64 i = 0;
+  while(i < n){
+    u64 b = irqbench_bucket(ticks_to_ns(irqbench_samples[i]));
+    u64 count = 0;
+    for(; i < n; i++){
+      if(irqbench_bucket(ticks_to_ns(irqbench_samples[i])) != b) break;
+      count++;
+    }
+    if(b == 0){
+      uart1_printf("  [0] ns: %u\n", count);
+    } else {
+      uart1_printf("  [%u-%u] ns: %u\n", 1ULL << (b - 1), (1ULL << b) - 1,
+                   count);
+    }
+  }
+}
+
+int irqbench(size_t argc, char **argv){
+  if(argc > 2){
+    uart1_printf("Error: \"%s\" expects at most one argument.\n", argv[0]);
+    return 1;
+  }
+
+  u64 n = IRQBENCH_DEFAULT_SAMPLES;
+  if(argc == 2 && (!parse_u64(argv[1], &n) || n == 0 ||
+                   n > IRQBENCH_MAX_SAMPLES)){
+    uart1_printf("Error: ARG1 should be a number of samples between 1 and "
+                 "%u.\n", (u64) IRQBENCH_MAX_SAMPLES);
+    return 1;
+  }
+
+  if(!irq_register(IRQ_CNTV, "irqbench", irqbench_irq, NULL)){
+    uart1_printf("Error: the virtual timer IRQ is already in use.\n");
+    return 1;
+  }
+  u64 self = smp_core_id();
+  write_cntv_ctl_el0(0);
+  *LOCAL_TIMER_IRQ_CNTL(self) |= LOCAL_TIMER_CNTV_IRQ;
+
+  uart1_printf("Timer IRQ latency on core %u (%u samples per run):\n", self, n);
+
+  static const char *configs[] = {
+    "caches, idle", "no caches, idle", "caches, load", "no caches, load"
+  };
+  bool ok = true;
+  for(u64 c = 0; c < 4 && ok; c++){
+    bool cold = c & 1;
+    bool load = c & 2;
+
+    // Start the load on the other (idle) cores.
+    u64 loaded = 0;
+    if(load){
+      irqbench_stop = 0;
+      dmb_ish();
+      for(u64 core = 0; core < NB_CORES; core++){
+        if(core != self && smp_run_on(core, irqbench_load, NULL)){
+          loaded |= 1ULL << core;
+        }
+      }
+      if(loaded == 0) uart1_printf("(No idle core to run the load.)\n");
+    }
+
+    // Instruction fetches bypass the caches in the "no caches" runs, and the
+    // data caches and TLB are flushed before each sample.
+    u64 sctlr = read_sctlr_el1();
+    if(cold){
+      write_sctlr_el1(sctlr & ~SCTLR_I);
+      isb();
+    }
+    ok = irqbench_sample(n, cold);
+    if(cold){
+      write_sctlr_el1(sctlr);
+      asm volatile("ic iallu; dsb nsh; isb" : : : "memory");
+    }
+
+    if(load){
+      atomic_store_release(&irqbench_stop, 1);
+      for(u64 core = 0; core < NB_CORES; core++){
+        if((loaded >> core) & 1) smp_wait(core);
+      }
+    }
+
+    if(ok) irqbench_report(configs[c], n);
+  }
+
+  *LOCAL_TIMER_IRQ_CNTL(self) &= ~LOCAL_TIMER_CNTV_IRQ;
+  irq_unregister(IRQ_CNTV);
+
+  if(!ok){
+    uart1_printf("Error: timer interrupt not received.\n");
+    return 1;
+  }
+  return 0;
+}
+
+// Sampling profiler of EL1 (the "profile" command). While profiling, the
+// virtual timer of each online core interrupts it every PROFILE_PERIOD_US, and
+// the handler adds one sample to the function containing the interrupted PC (in
+// the table embedded in the image, see "kernel/symbols.h"). Each core counts
+// its samples in scratch memory, with one more slot for PCs outside of the
+// kernel code. Code running with IRQs masked cannot be interrupted: its samples
+// go to the code that unmasks IRQs.
+#define PROFILE_PERIOD_US   1000
+#define PROFILE_MAX_SECONDS 3600
+#define PROFILE_DEFAULT_TOP 10
+#define PROFILE_STOP_US     100000
+
+// Sampling period (in timer ticks), cores being sampled, whether sampling is
+// being stopped, and whether the IRQ is still registered (after a failed stop).
+static u64 profile_period;
+static volatile bool profile_started[NB_CORES];
+static volatile bool profile_stopping;
+static bool profile_pending;
+
+static u64 *profile_counts(u64 core){
+  return (u64 *) scratch_memory() + core * (kernel_nb_symbols + 1);
+}
+
+static void profile_stop_core(void *arg){
+  UNUSED(arg);
+  u64 core = smp_core_id();
+  *LOCAL_TIMER_IRQ_CNTL(core) &= ~LOCAL_TIMER_CNTV_IRQ;
+  write_cntv_ctl_el0(0);
+  profile_started[core] = false;
+}
+
+// Handler of the virtual timer. The next deadline is set from the time the IRQ
+// was taken, so that the sampling jitters with the latency instead of staying
+// in phase with periodic code. Once sampling is being stopped, the core stops
+// by itself (in case it was too busy to run "profile_stop_core").
+static void profile_irq(void *arg){
+  if(profile_stopping){
+    profile_stop_core(arg);
+    return;
+  }
+  const symbol *sym = symbol_lookup(irq_frame()->elr);
+  u64 i = sym == NULL ? kernel_nb_symbols : (u64) (sym - kernel_symbols);
+  profile_counts(smp_core_id())[i]++;
+  write_cntv_cval_el0(irq_entry_ticks() + profile_period);
+}
+
+static void profile_start_core(void *arg){
+  UNUSED(arg);
+  u64 core = smp_core_id();
+  u64 *counts = profile_counts(core);
+  for(u64 i = 0; i <= kernel_nb_symbols; i++) counts[i] = 0;
+  profile_started[core] = true;
+
+  write_cntv_cval_el0(counter_ticks() + profile_period);
+  write_cntv_ctl_el0(CNTV_CTL_ENABLE);
+  *LOCAL_TIMER_IRQ_CNTL(core) |= LOCAL_TIMER_CNTV_IRQ;
+}
+
+// Stop sampling the cores of the mask, and release the IRQ once all the cores
+// are stopped. Returns false (and keeps the IRQ) if some core did not stop
+// within PROFILE_STOP_US: its counts are then still changing.
+static bool profile_stop(u64 mask){
+  profile_stopping = true;
+  run_on_cores(mask, profile_stop_core, NULL);
+  u64 start = counter_ticks();
+  u64 timeout = timer_us_to_ticks(PROFILE_STOP_US);
+  bool ok;
+  do {
+    ok = true;
+    for(u64 core = 0; core < NB_CORES; core++){
+      if(profile_started[core]) ok = false;
+    }
+  } while(!ok && counter_ticks() - start < timeout);
+
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(profile_started[core]){
+      uart1_printf("Error: cannot stop profiling on core %u (are IRQs masked "
+                   "on it?).\n", core);
+    }
+  }
+  if(ok) irq_unregister(IRQ_CNTV);
+  profile_pending = !ok;
+  return ok;
+}
+
+int profile(size_t argc, char **argv){
+  if(argc < 2 || argc > 3){
+    uart1_printf("Error: usage is \"%s SECONDS [N]\".\n", argv[0]);
+    return 1;
+  }
+
+  u64 seconds;
+  if(!parse_u64(argv[1], &seconds) || seconds == 0 ||
+     seconds > PROFILE_MAX_SECONDS){
+    uart1_printf("Error: ARG1 should be a number of seconds between 1 and "
+                 "%u.\n", (u64) PROFILE_MAX_SECONDS);
+    return 1;
+  }
+
+  u64 top = PROFILE_DEFAULT_TOP;
+  if(argc == 3 && !parse_u64(argv[2], &top)){
+    uart1_printf("Error: ARG2 should be a number.\n");
+    return 1;
+  }
+
+  if(kernel_nb_symbols == 0){
+    uart1_printf("Error: the image has no symbol table.\n");
+    return 1;
+  }
+  if(profile_pending && !profile_stop(0)) return 1;
+  if(!irq_register(IRQ_CNTV, "profile", profile_irq, NULL)){
+    uart1_printf("Error: the virtual timer IRQ is already in use.\n");
+    return 1;
+  }
+
+  // Sample all the online cores. A profile missing some of them (because they
+  // are busy) would be wrong, so none is made.
+  profile_period = timer_us_to_ticks(PROFILE_PERIOD_US);
+  profile_stopping = false;
+  u64 online = online_cores();
+  if(!run_on_cores(online, profile_start_core, NULL)){
+    u64 mask = 0;
+    for(u64 core = 0; core < NB_CORES; core++){
+      if(profile_started[core]){
+        mask |= 1ULL << core;
+      } else if((online >> core) & 1){
+        uart1_printf("Error: core %u is busy (profiling was not started on "
+                     "it).\n", core);
+      }
+    }
+    profile_stop(mask);
+    return 1;
+  }
+
+  thread_sleep_us(seconds * 1000000);
+
+  if(!profile_stop(online)) return 1;
+
+  // Add up the counts of the sampled cores in those of the first one.
+  u64 *total_counts = NULL;
+  u64 total = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(!((online >> core) & 1)) continue;
+    u64 *counts = profile_counts(core);
+    for(u64 i = 0; i <= kernel_nb_symbols; i++){
+      total += counts[i];
+      if(total_counts == NULL) continue;
+      total_counts[i] += counts[i];
+    }
+    if(total_counts == NULL) total_counts = counts;
+  }
+
+  uart1_printf("%u samples in %u s on %u cores (every %u us).\n", total,
+               seconds, (u64) __builtin_popcountll(online),
+               (u64) PROFILE_PERIOD_US);
+  if(total == 0) return 0;
+
+  // Print the hottest functions (each is cleared once printed).
+  for(u64 k = 0; k < top; k++){
+    u64 best = 0;
+    for(u64 i = 1; i <= kernel_nb_symbols; i++){
+      if(total_counts[i] > total_counts[best]) best = i;
+    }
+    u64 count = total_counts[best];
+    if(count == 0) break;
+    total_counts[best] = 0;
+
+    const char *name = best == kernel_nb_symbols
+      ? "(outside of the kernel code)" : kernel_symbols[best].name;
+    uart1_printf("%u %u%% %s\n", count, count * 100 / total, name);
+  }
+  return 0;
+}
+
+// Maximum number of timers armed by "timers test", and maximum delay (in us).
+#define TIMERS_TEST_MAX      4096
+#define TIMERS_TEST_MAX_US   2000000
+
+// Maximum number of pending timers listed by "timers".
+#define TIMERS_DUMP_MAX 16
+
+static wtimer timers_test[TIMERS_TEST_MAX];
+static volatile u64 timers_test_fired;
+
+static void timers_test_fn(void *arg){
+  UNUSED(arg);
+  timers_test_fired++;
+}
+
+// Arm n timers with pseudo-random delays (xorshift generator).
+static void timers_arm_test(u64 n){
+  u64 seed = counter_ticks() | 1;
+  timers_test_fired = 0;
+
+  for(u64 i = 0; i < n; i++){
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    wtimer_init(&(timers_test[i]), timers_test_fn, NULL);
+    wtimer_arm(&(timers_test[i]), seed % TIMERS_TEST_MAX_US);
+  }
+
+  uart1_printf("Armed %u timers (delays up to %u us) on core %u.\n", n,
+               (u64) TIMERS_TEST_MAX_US, smp_core_id());
+}
+
+int timers(size_t argc, char **argv){
+  if(argc == 3 && strcmp(argv[1], "test") == 0){
+    u64 n;
+    if(!parse_u64(argv[2], &n) || n == 0 || n > TIMERS_TEST_MAX){
+      uart1_printf("Error: ARG2 should be between 1 and %u.\n",
+                   (u64) TIMERS_TEST_MAX);
+      return 1;
+    }
+    // Timers can only be cancelled on the core where they were armed.
+    for(u64 i = 0; i < TIMERS_TEST_MAX; i++){
+      wtimer *t = &(timers_test[i]);
+      if(wtimer_pending(t) && t->core != smp_core_id()){
+        uart1_printf("Error: test timers still pending on core %u.\n",
+                     t->core);
+        return 1;
+      }
+    }
+    for(u64 i = 0; i < TIMERS_TEST_MAX; i++){
+      wtimer_cancel(&(timers_test[i]));
+    }
+    timers_arm_test(n);
+    return 0;
+  }
+  if(argc == 2 && strcmp(argv[1], "reset") == 0){
+    twheel_reset_stats();
+    return 0;
+  }
+  if(argc != 1){
+    uart1_printf("Error: usage is \"%s [reset | test N]\".\n", argv[0]);
+    return 1;
+  }
+
+  // Pending timers of the calling core.
+  wtimer *ts[TIMERS_DUMP_MAX];
+  u64 nb = twheel_pending(ts, TIMERS_DUMP_MAX);
+  u64 now = counter_ticks();
+  uart1_printf("Pending timers on core %u (at most %u shown):\n",
+               smp_core_id(), (u64) TIMERS_DUMP_MAX);
+  uart1_printf("CALLBACK\t\t\tLEVEL\tSLOT\tREMAINING(us)\n");
+  for(u64 i = 0; i < nb; i++){
+    wtimer *t = ts[i];
+    u64 left = t->deadline > now ? ticks_to_us(t->deadline - now) : 0;
+    uart1_printf("0x%w\t%u\t%u\t%u\n", (u64) t->fn, t->level, t->slot, left);
+  }
+  if(timers_test_fired){
+    uart1_printf("(%u test timers fired so far.)\n", timers_test_fired);
+  }
+
+  // Statistics of all the cores.
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(!smp_is_online(core)) continue;
+    twheel_stats s;
+    twheel_get_stats(core, &s);
+
+    uart1_printf("Core %u: %u pending, %u armed, %u cancelled, %u expired in "
+                 "%u batches (max %u), %u cascaded.\n", core, s.nb_pending,
+                 s.nb_armed, s.nb_cancelled, s.nb_expired, s.nb_batches,
+                 s.max_batch, s.nb_cascaded);
+    if(s.nb_expired == 0) continue;
+
+    uart1_printf("  Lateness (us):");
+    for(u64 b = 0; b < TWHEEL_HIST_SIZE; b++){
+      if(s.hist[b] == 0) continue;
+      if(b == 0){
+        uart1_printf(" [0]: %u", s.hist[b]);
+      } else {
+        uart1_printf(" [%u-%u]: %u", 1ULL << (b - 1), (1ULL << b) - 1,
+                     s.hist[b]);
+      }
+    }
+    uart1_printf("\n");
+  }
+
+  return 0;
+}
+
+// Printable names of thread states (padded to the same width).
+static const char *thread_states[] = {
+  "free    ", "ready   ", "running ", "sleeping", "waiting ", "dead    "
+};
+
+int ps(size_t argc, char **argv){
+  if(argc != 1){
+    uart1_printf("Error: \"%s\" expects no arguments.\n", argv[0]);
+    return 1;
+  }
+
+  thread *ts[MAX_THREADS + NB_CORES];
+  u64 nb = thread_list(ts, MAX_THREADS + NB_CORES);
+
+  uart1_printf("ID\tCORE\tPRIO\tSTATE\t\tRUNTIME(us)\tSWITCHES\tPREEMPTED\tNAME\n");
+  for(u64 i = 0; i < nb; i++){
+    thread *t = ts[i];
+    uart1_printf("%u\t%u\t%u\t%s\t%u\t\t%u\t\t%u\t\t%s\n",
+                 t->id, t->core, t->prio, thread_states[t->state],
+                 ticks_to_us(t->runtime), t->nb_switches, t->nb_preempted,
+                 t->name);
+  }
+  return 0;
+}
+
+int sched(size_t argc, char **argv){
+  if(argc > 3){
+    uart1_printf("Error: \"%s\" expects at most two arguments.\n", argv[0]);
+    return 1;
+  }
+
+  if(argc >= 2){
+    u64 mode;
+    if(strcmp(argv[1], "periodic") == 0){
+      mode = SCHED_PERIODIC;
+    } else if(strcmp(argv[1], "tickless") == 0){
+      mode = SCHED_TICKLESS;
+    } else {
+      uart1_printf("Error: ARG1 should be \"periodic\" or \"tickless\".\n");
+      return 1;
+    }
+
+    u64 slice = sched_slice_us();
+    if(argc == 3 && (!parse_u64(argv[2], &slice) || slice == 0)){
+      uart1_printf("Error: ARG2 should be a positive number of microseconds.\n");
+      return 1;
+    }
+
+    sched_configure(mode, slice);
+  }
+
+  uart1_printf("Timer mode: %s, time slice: %u us.\n",
+               sched_mode() == SCHED_TICKLESS ? "tickless" : "periodic",
+               sched_slice_us());
+  return 0;
+}
+
 // Fill in the list of commands (exposed by "include/kernel/commands.h").
 cmd_descr cmds[] = {
   { .name = "help",
@@ -129,6 +2578,87 @@ cmd_descr cmds[] = {
   { .name = "get",
     .doc  = "get the value of the secret counter via un hypervisor call",
     .func = get },
+  { .name = "hvcbench",
+    .doc  = "measure hypercall round trips, against plain function calls",
+    .func = hvcbench },
+  { .name = "hvcbatch",
+    .doc  = "compare batched hypercalls (shared ring) against one trap per op",
+    .func = hvcbatch },
+  { .name = "hvcstress",
+    .doc  = "concurrent hypercalls on all the cores, checking the total",
+    .func = hvcstress },
+  { .name = "stage2",
+    .doc  = "stage-2 fault counters, \"probe\" reads memory private to EL2",
+    .func = stage2 },
+  { .name = "vuart",
+    .doc  = "virtual UART counters, \"on\"/\"off\" toggle, \"bench\"",
+    .func = vuart },
+  { .name = "guests",
+    .doc  = "time-slice EL1 guests at EL2 (ARG1 us slices), CPU time per guest",
+    .func = guests },
+  { .name = "prof",
+    .doc  = "sample EL1 PCs from EL2 every ARG2 cycles, \"show [N]\" hot spots",
+    .func = prof },
+  { .name = "mmio",
+    .doc  = "trace MMIO accesses at EL2, \"show [N]\" registers and sites",
+    .func = mmio },
+  { .name = "pool",
+    .doc  = "show (or set to ARG1) the number of cores of the task pool",
+    .func = pool },
+  { .name = "crc",
+    .doc  = "compute the CRC-32 of ARG2 bytes at ARG1 using the task pool",
+    .func = crc },
+  { .name = "wsbench",
+    .doc  = "measure the CRC-32 speedup with 1 to 4 cores (ARG1 bytes)",
+    .func = wsbench },
+  { .name = "ctxbench",
+    .doc  = "measure the cost of ARG1 thread context switch round trips",
+    .func = ctxbench },
+  { .name = "ipibench",
+    .doc  = "measure IPI round trips between all core pairs (ARG1 rounds)",
+    .func = ipibench },
+  { .name = "qbench",
+    .doc  = "measure SPSC/MPSC queue throughput between cores (ARG1 messages)",
+    .func = qbench },
+  { .name = "pcpubench",
+    .doc  = "compare shared and per-core counters on all cores (ARG1 times)",
+    .func = pcpubench },
+  { .name = "console",
+    .doc  = "start the console on core ARG1, stop it (\"off\"), or \"bench\"",
+    .func = console },
+  { .name = "membench",
+    .doc  = "measure memory copy bandwidth with ARG1-byte buffers",
+    .func = membench },
+  { .name = "smp",
+    .doc  = "run a command on a set of cores (ARG1, e.g. \"0-3\"), and scale",
+    .func = smp },
+  { .name = "perf",
+    .doc  = "run a command (ARG1 and arguments), and print PMU event counts",
+    .func = perf },
+  { .name = "irqstat",
+    .doc  = "show (or \"reset\") per-IRQ counters and latencies",
+    .func = irqstat },
+  { .name = "gpiocap",
+    .doc  = "stream timestamped edges of the given GPIO pins",
+    .func = gpiocap },
+  { .name = "gpiobench",
+    .doc  = "measure the GPIO toggle rate (bit-banging)",
+    .func = gpiobench },
+  { .name = "irqbench",
+    .doc  = "timer IRQ latency histograms, with(out) caches and load",
+    .func = irqbench },
+  { .name = "profile",
+    .doc  = "sample PCs for ARG1 seconds, and print the ARG2 hottest functions",
+    .func = profile },
+  { .name = "timers",
+    .doc  = "list timers and lateness, \"reset\" stats, or \"test N\" timers",
+    .func = timers },
+  { .name = "ps",
+    .doc  = "list the threads, with scheduling statistics",
+    .func = ps },
+  { .name = "sched",
+    .doc  = "show or set the timer mode (ARG1) and time slice (ARG2, in us)",
+    .func = sched },
   // Dummy list terminator.
   { .name = NULL, .doc = NULL, .func = NULL }
 };
@@ -0,0 +1,153 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <macros.h>
+#include <string.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/uart1.h>
+#include <kernel/console.h>
+#include <kernel/irq.h>
+#include <kernel/queue.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+
+// Number of records in the queue of each core.
+#define CONSOLE_QUEUE_SIZE 64
+
+// Records are only written out once they are that old (in microseconds), so
+// that records pushed slightly late by another core can still be merged in
+// timestamp order.
+#define CONSOLE_REORDER_US 50
+
+// An output record (two cache lines).
+typedef struct {
+  u64 time;                      // Timestamp (generic timer ticks).
+  u64 len;                       // Number of characters in text.
+  char text[CONSOLE_RECORD_TEXT];
+} console_record;
+
+SPSC_QUEUE_DEFINE(console_queue, console_record, CONSOLE_QUEUE_SIZE)
+
+// Queue of each (producing) core. Each queue has a single producer, since
+// IRQs are masked while pushing records: the threads and IRQ handlers of the
+// core cannot interleave.
+static console_queue queues[NB_CORES];
+
+static volatile u64 enabled = 0;  // Is the console core running?
+static volatile u64 stopping = 0; // Has the console core been asked to stop?
+static u64 core_running = 0;      // Core running the console.
+
+// Statistics.
+static volatile u64 nb_records = 0;
+static volatile u64 nb_full = 0;
+
+// Write out the oldest record at the head of a queue, if it is at least delay
+// ticks old. Returns false if no record was written.
+static bool write_oldest(u64 delay){
+  console_record *oldest = NULL;
+  u64 src = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    console_record *r = console_queue_peek(&(queues[core]));
+    if(r && (oldest == NULL || r->time < oldest->time)){
+      oldest = r;
+      src = core;
+    }
+  }
+
+  if(oldest == NULL || counter_ticks() < oldest->time + delay) return false;
+
+  for(u64 i = 0; i < oldest->len; i++){
+    uart1_raw_putc(oldest->text[i]);
+  }
+
+  console_record done;
+  console_queue_pop(&(queues[src]), &done);
+  nb_records++;
+  return true;
+}
+
+// Main loop of the console core.
+static void console_main(void *arg){
+  UNUSED(arg);
+  u64 delay = timer_us_to_ticks(CONSOLE_REORDER_US);
+
+  while(!atomic_load_acquire(&stopping)){
+    write_oldest(delay);
+  }
+
+  // Write out everything that is left, without waiting for late records.
+  while(write_oldest(0));
+}
+
+bool console_start(u64 core){
+  if(atomic_load_acquire(&enabled)) return false;
+
+  for(u64 c = 0; c < NB_CORES; c++){
+    console_queue_init(&(queues[c]));
+  }
+  stopping = 0;
+  nb_records = 0;
+  nb_full = 0;
+  dmb_ish();
+
+  if(!smp_run_on(core, console_main, NULL)) return false;
+  core_running = core;
+  atomic_store_release(&enabled, 1);
+  return true;
+}
+
+void console_stop(){
+  if(!atomic_load_acquire(&enabled)) return;
+
+  atomic_store_release(&stopping, 1);
+  smp_wait(core_running);
+  atomic_store_release(&enabled, 0);
+
+  // Records may have been pushed after the console core was done: we are now
+  // the consumer of the queues (new output goes directly to the UART).
+  while(write_oldest(0));
+}
+
+bool console_enabled(){
+  return atomic_load_acquire(&enabled);
+}
+
+u64 console_core(){
+  return core_running;
+}
+
+void console_write(const char *s, u64 len){
+  console_queue *q = &(queues[smp_core_id()]);
+
+  while(len > 0){
+    u64 n = len < CONSOLE_RECORD_TEXT ? len : CONSOLE_RECORD_TEXT;
+
+    // IRQs are masked so that the queue has a single producer.
+    u64 flags = irq_save();
+    console_record r;
+    r.time = counter_ticks();
+    r.len = n;
+    memcpy(r.text, s, n);
+    while(!console_queue_push(q, &r)){
+      // The queue is full: let other threads run (if possible).
+      atomic_fetch_add(&nb_full, 1);
+      irq_restore(flags);
+      thread_yield();
+      flags = irq_save();
+    }
+    irq_restore(flags);
+
+    s += n;
+    len -= n;
+  }
+}
+
+u64 console_nb_records(){
+  return nb_records;
+}
+
+u64 console_nb_full(){
+  return nb_full;
+}
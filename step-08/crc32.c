@@ -0,0 +1,100 @@
+#include <types.h>
+#include <crc32.h>
+
+// Reversed representation of the CRC-32 polynomial.
+#define CRC32_POLY 0xedb88320U
+
+static u32 crc32_table[256];
+
+void crc32_init(){
+  for(u32 i = 0; i < 256; i++){
+    u32 c = i;
+    for(int k = 0; k < 8; k++){
+      c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+    }
+    crc32_table[i] = c;
+  }
+}
+
+u32 crc32_update(u32 crc, const u8 *buf, u64 len){
+  u32 c = ~crc;
+  for(u64 i = 0; i < len; i++){
+    c = crc32_table[(c ^ buf[i]) & 0xff] ^ (c >> 8);
+  }
+  return ~c;
+}
+
+// The combination relies on the fact that appending len2 zero bytes to a
+// message is a linear operation on its CRC, represented by a 32x32 matrix
+// over GF(2). The matrix is computed by repeated squaring of the operator
+// appending a single zero bit (so it takes a logarithmic number of steps).
+
+// Multiply the vector vec by the matrix mat (given as 32 columns).
+static u32 gf2_matrix_times(const u32 *mat, u32 vec){
+  u32 sum = 0;
+  while(vec){
+    if(vec & 1) sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+// Compute the square of the matrix mat into square.
+static void gf2_matrix_square(u32 *square, const u32 *mat){
+  for(int n = 0; n < 32; n++){
+    square[n] = gf2_matrix_times(mat, mat[n]);
+  }
+}
+
+void crc32_combine_gen(u32 *op, u64 len2){
+  u32 even[32]; // Operator for an even power of two zero bits.
+  u32 odd[32];  // Operator for an odd power of two zero bits.
+
+  // Start from the identity.
+  for(int n = 0; n < 32; n++){
+    op[n] = 1U << n;
+  }
+
+  if(len2 == 0) return;
+
+  // Operator for a single zero bit.
+  odd[0] = CRC32_POLY;
+  u32 row = 1;
+  for(int n = 1; n < 32; n++){
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  // Operators for two and four zero bits.
+  gf2_matrix_square(even, odd);
+  gf2_matrix_square(odd, even);
+
+  // Compose the operators for len2 zero bytes (the first square gives one
+  // zero byte). All the operators are powers of the same matrix, so the order
+  // in which they are composed does not matter.
+  do {
+    gf2_matrix_square(even, odd);
+    if(len2 & 1){
+      for(int n = 0; n < 32; n++) op[n] = gf2_matrix_times(even, op[n]);
+    }
+    len2 >>= 1;
+    if(len2 == 0) break;
+
+    gf2_matrix_square(odd, even);
+    if(len2 & 1){
+      for(int n = 0; n < 32; n++) op[n] = gf2_matrix_times(odd, op[n]);
+    }
+    len2 >>= 1;
+  } while(len2 != 0);
+}
+
+u32 crc32_combine_op(const u32 *op, u32 crc1, u32 crc2){
+  return gf2_matrix_times(op, crc1) ^ crc2;
+}
+
+u32 crc32_combine(u32 crc1, u32 crc2, u64 len2){
+  u32 op[32];
+  crc32_combine_gen(op, len2);
+  return crc32_combine_op(op, crc1, crc2);
+}
@@ -0,0 +1,76 @@
+#include <stdbool.h>
+#include <bits.h>
+#include <types.h>
+#include <bcm2837/gpio.h>
+#include <kernel/clock.h>
+#include <kernel/irq.h>
+
+// Number of function select registers (10 pins each, on 3 bits).
+#define NB_FSEL_REGS 6
+
+// Cached values of the function select registers, and mask of the registers
+// whose cached value is valid (they are read on first use).
+static u32 fsel_cache[NB_FSEL_REGS];
+static u32 fsel_valid = 0;
+
+// Cached value of the given function select register.
+static u32 fsel_read(u64 reg){
+  if(!((fsel_valid >> reg) & 1)){
+    fsel_cache[reg] = *(GPFSEL0 + reg);
+    fsel_valid |= BIT_U32(reg);
+  }
+  return fsel_cache[reg];
+}
+
+// Write the given function select register, unless it is unchanged.
+static void fsel_write(u64 reg, u32 v){
+  if(fsel_read(reg) == v) return;
+  *(GPFSEL0 + reg) = v;
+  fsel_cache[reg] = v;
+}
+
+void gpio_set_function_mask(u64 mask, u32 fsel){
+  mask &= (1ULL << GPIO_NB_PINS) - 1;
+
+  u64 flags = irq_save();
+  for(u64 reg = 0; reg < NB_FSEL_REGS; reg++){
+    u64 pins = (mask >> (10 * reg)) & MASK_U32(0, 10);
+    if(pins == 0) continue;
+
+    u32 v = fsel_read(reg);
+    while(pins){
+      u32 shift = 3 * __builtin_ctzll(pins);
+      pins &= pins - 1;
+      v = (v & ~(MASK_U32(0, 3) << shift)) | (fsel << shift);
+    }
+    fsel_write(reg, v);
+  }
+  irq_restore(flags);
+}
+
+void gpio_set_function(u64 pin, u32 fsel){
+  if(pin >= GPIO_NB_PINS) return;
+  gpio_set_function_mask(1ULL << pin, fsel);
+}
+
+u32 gpio_get_function(u64 pin){
+  if(pin >= GPIO_NB_PINS) return GPFSEL_IN;
+
+  u64 flags = irq_save();
+  u32 v = fsel_read(pin / 10);
+  irq_restore(flags);
+  return (v >> (3 * (pin % 10))) & MASK_U32(0, 3);
+}
+
+void gpio_pull(u64 mask, u32 pud){
+  mask &= (1ULL << GPIO_NB_PINS) - 1;
+
+  *GPPUD = pud;           // Set the configuration we want to write.
+  ndelay(GPPUD_SETUP_NS); // Wait for the control signal to be set up.
+  *GPPUDCLK0 = (u32) mask;         // Assert the clock on the pins of mask.
+  *GPPUDCLK1 = (u32) (mask >> 32);
+  ndelay(GPPUD_SETUP_NS); // Wait for the clock to be taken into account.
+  *GPPUD = GPPUD_OFF;     // Remove the control signal.
+  *GPPUDCLK0 = 0;         // Remove the clock.
+  *GPPUDCLK1 = 0;
+}
@@ -0,0 +1,164 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <bits.h>
+#include <macros.h>
+#include <types.h>
+#include <bcm2837/armctrl.h>
+#include <bcm2837/gpio.h>
+#include <kernel/gpiocap.h>
+#include <kernel/irq.h>
+#include <kernel/queue.h>
+
+// Pins used by UART1 (see "uart1.c"), which cannot be captured.
+#define UART1_PINS ((1ULL << 14) | (1ULL << 15))
+
+// Maximum number of events pushed at once by the handler (one per pin).
+#define MAX_BATCH GPIOCAP_NB_PINS
+
+SPSC_QUEUE_DEFINE(gpiocap_ring, gpiocap_event, GPIOCAP_RING_SIZE)
+
+// Ring of captured events. Its producer is the interrupt handler (GPU IRQs are
+// all routed to core 0), and its consumer the caller of "gpiocap_pop".
+static gpiocap_ring ring;
+
+static bool installed = false; // Is the interrupt handler installed?
+static u64 rising = 0;         // Pins capturing rising edges.
+static u64 falling = 0;        // Pins capturing falling edges.
+
+// Statistics.
+static volatile u64 nb_events = 0;
+static volatile u64 nb_dropped = 0;
+
+// Set (or clear) the bit of the given pin in the pair of registers r0 / r1.
+static void set_pin_bit(volatile u32 *r0, volatile u32 *r1, u64 pin, bool on){
+  volatile u32 *r = pin < 32 ? r0 : r1;
+  u32 bit = BIT_U32(pin % 32);
+  if(on){
+    *r |= bit;
+  } else {
+    *r &= ~bit;
+  }
+}
+
+// Handler for the GPIO interrupts (of all banks).
+static void gpio_irq(void *arg){
+  UNUSED(arg);
+  u64 time = irq_entry_ticks();
+
+  // Clear the detected events first, so that edges occurring while we handle
+  // them raise a new interrupt.
+  u64 status = *GPEDS0 | ((u64) *GPEDS1 << 32);
+  *GPEDS0 = (u32) status;
+  *GPEDS1 = (u32) (status >> 32);
+  u64 level = *GPLEV0 | ((u64) *GPLEV1 << 32);
+
+  gpiocap_event events[MAX_BATCH];
+  u64 n = 0;
+  while(status){
+    u64 pin = __builtin_ctzll(status);
+    status &= status - 1;
+
+    u64 mask = 1ULL << pin;
+    u64 edge;
+    if((rising & mask) && (falling & mask)){
+      edge = (level & mask) ? GPIOCAP_RISING : GPIOCAP_FALLING;
+    } else if(rising & mask){
+      edge = GPIOCAP_RISING;
+    } else if(falling & mask){
+      edge = GPIOCAP_FALLING;
+    } else {
+      continue;
+    }
+
+    events[n].time = time;
+    events[n].pin = pin;
+    events[n].edge = edge;
+    n++;
+  }
+
+  u64 pushed = gpiocap_ring_push_bulk(&ring, events, n);
+  nb_events += n;
+  nb_dropped += n - pushed;
+}
+
+// Install the interrupt handler on first use.
+static bool install(){
+  if(installed) return true;
+
+  if(!irq_register(IRQ_GPU(GPU_IRQ_GPIO_0), "gpio0", gpio_irq, NULL) ||
+     !irq_register(IRQ_GPU(GPU_IRQ_GPIO_1), "gpio1", gpio_irq, NULL) ||
+     !irq_register(IRQ_GPU(GPU_IRQ_GPIO_2), "gpio2", gpio_irq, NULL)){
+    return false;
+  }
+  irq_unmask_source(IRQ_GPU(GPU_IRQ_GPIO_0));
+  irq_unmask_source(IRQ_GPU(GPU_IRQ_GPIO_1));
+  irq_unmask_source(IRQ_GPU(GPU_IRQ_GPIO_2));
+
+  installed = true;
+  return true;
+}
+
+bool gpiocap_enable(u64 pin, u64 flags){
+  if(pin >= GPIOCAP_NB_PINS || ((UART1_PINS >> pin) & 1)) return false;
+  if(!(flags & (GPIOCAP_RISING | GPIOCAP_FALLING))) return false;
+
+  u64 irq_flags = irq_save();
+  if(!install()){
+    irq_restore(irq_flags);
+    return false;
+  }
+
+  gpio_set_function(pin, GPFSEL_IN);
+
+  bool async = flags & GPIOCAP_ASYNC;
+  bool up = flags & GPIOCAP_RISING;
+  bool down = flags & GPIOCAP_FALLING;
+  set_pin_bit(GPREN0, GPREN1, pin, up && !async);
+  set_pin_bit(GPFEN0, GPFEN1, pin, down && !async);
+  set_pin_bit(GPAREN0, GPAREN1, pin, up && async);
+  set_pin_bit(GPAFEN0, GPAFEN1, pin, down && async);
+
+  u64 mask = 1ULL << pin;
+  rising = up ? rising | mask : rising & ~mask;
+  falling = down ? falling | mask : falling & ~mask;
+  irq_restore(irq_flags);
+  return true;
+}
+
+void gpiocap_disable(u64 pin){
+  if(pin >= GPIOCAP_NB_PINS || ((UART1_PINS >> pin) & 1)) return;
+
+  u64 irq_flags = irq_save();
+  set_pin_bit(GPREN0, GPREN1, pin, false);
+  set_pin_bit(GPFEN0, GPFEN1, pin, false);
+  set_pin_bit(GPAREN0, GPAREN1, pin, false);
+  set_pin_bit(GPAFEN0, GPAFEN1, pin, false);
+
+  // Clear a possibly pending event of the pin (bits are cleared by writing 1).
+  *(pin < 32 ? GPEDS0 : GPEDS1) = BIT_U32(pin % 32);
+
+  rising &= ~(1ULL << pin);
+  falling &= ~(1ULL << pin);
+  irq_restore(irq_flags);
+}
+
+void gpiocap_reset(){
+  for(u64 pin = 0; pin < GPIOCAP_NB_PINS; pin++){
+    if((rising | falling) & (1ULL << pin)) gpiocap_disable(pin);
+  }
+
+  gpiocap_event e;
+  while(gpiocap_pop(&e));
+}
+
+bool gpiocap_pop(gpiocap_event *e){
+  return gpiocap_ring_pop(&ring, e);
+}
+
+u64 gpiocap_nb_events(){
+  return nb_events;
+}
+
+u64 gpiocap_nb_dropped(){
+  return nb_dropped;
+}
@@ -0,0 +1,275 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/local.h>
+#include <kernel/guest.h>
+#include <kernel/smp.h>
+
+// Bits of HCR_EL2: route physical IRQs to EL2 (which also enables virtual
+// IRQs at EL1), and signal a virtual IRQ.
+#define HCR_IMO (1ULL << 4)
+#define HCR_VI  (1ULL << 7)
+
+// Bit of CNTHP_CTL_EL2 enabling the timer (with its interrupt unmasked).
+#define CNTHP_ENABLE 1ULL
+
+// Initial PSTATE of guests: EL1 with SP_EL0, with only IRQs unmasked.
+#define GUEST_SPSR 0x344ULL
+
+// EL1 exception handling registers, thread ID registers, and timer control.
+typedef struct {
+  u64 sp_el0;
+  u64 sp_el1;
+  u64 vbar;
+  u64 elr;
+  u64 spsr;
+  u64 esr;
+  u64 far;
+  u64 tpidr_el0;
+  u64 tpidr_el1;
+  u64 cntkctl;
+} el1_state;
+
+// Saved state of a world (a guest, or the host).
+typedef struct {
+  hvc_frame frame;
+  el1_state el1;
+  u64 state;        // One of the GUEST_* states (for guests).
+  guest_info *info; // Description (in EL1 memory) of the guest.
+  u64 start;        // Counter value when last switched in.
+} world;
+
+// Worlds of each core (in the memory private to EL2): the guests, and the host
+// (at index GUEST_MAX).
+#define HOST GUEST_MAX
+static world worlds[NB_CORES][GUEST_MAX + 1] __attribute__((section(".hyp")));
+
+// Scheduling state of each core.
+typedef struct {
+  u64 nb_guests;
+  bool running;  // Are guests running (instead of the host)?
+  u64 current;   // Index of the running (or last run) guest.
+  u64 slice;     // Length of a slice (in counter ticks).
+  guest_switch_stats stats;
+} __attribute__((aligned(64))) core_state;
+
+static core_state cores[NB_CORES] __attribute__((section(".hyp")));
+
+static void save_el1(el1_state *s){
+  s->sp_el0 = read_sp_el0();
+  s->sp_el1 = read_sp_el1();
+  s->vbar = read_vbar_el1();
+  s->elr = read_elr_el1();
+  s->spsr = read_spsr_el1();
+  s->esr = read_esr_el1();
+  s->far = read_far_el1();
+  s->tpidr_el0 = read_tpidr_el0();
+  s->tpidr_el1 = read_tpidr_el1();
+  s->cntkctl = read_cntkctl_el1();
+}
+
+static void load_el1(const el1_state *s){
+  write_sp_el0(s->sp_el0);
+  write_sp_el1(s->sp_el1);
+  write_vbar_el1(s->vbar);
+  write_elr_el1(s->elr);
+  write_spsr_el1(s->spsr);
+  write_esr_el1(s->esr);
+  write_far_el1(s->far);
+  write_tpidr_el0(s->tpidr_el0);
+  write_tpidr_el1(s->tpidr_el1);
+  write_cntkctl_el1(s->cntkctl);
+}
+
+// Index of the next runnable guest after guest i (possibly i itself), or HOST
+// if there are none.
+static u64 next_guest(u64 core, u64 i){
+  core_state *c = &(cores[core]);
+  for(u64 k = 1; k <= c->nb_guests; k++){
+    u64 g = (i + k) % c->nb_guests;
+    if(worlds[core][g].state == GUEST_READY) return g;
+  }
+  return HOST;
+}
+
+// Number of runnable guests.
+static u64 nb_ready(u64 core){
+  u64 n = 0;
+  for(u64 g = 0; g < cores[core].nb_guests; g++){
+    if(worlds[core][g].state == GUEST_READY) n++;
+  }
+  return n;
+}
+
+// Load the state of guest i into frame f (and the EL1 registers), inject a
+// virtual IRQ, and start a new slice.
+static void switch_in(hvc_frame *f, u64 core, u64 i){
+  core_state *c = &(cores[core]);
+  world *w = &(worlds[core][i]);
+  *f = w->frame;
+  load_el1(&(w->el1));
+  write_hcr_el2(read_hcr_el2() | HCR_IMO | HCR_VI);
+  write_cnthp_tval_el2(c->slice);
+  write_cnthp_ctl_el2(CNTHP_ENABLE);
+  c->current = i;
+  w->info->nb_slices++;
+  w->start = counter_ticks();
+}
+
+// Save the state of the running guest from frame f (and the EL1 registers),
+// and account for its time.
+static void switch_out(hvc_frame *f, u64 core){
+  world *w = &(worlds[core][cores[core].current]);
+  w->frame = *f;
+  save_el1(&(w->el1));
+  w->info->cpu_ticks += counter_ticks() - w->start;
+}
+
+// Load the state of the host into frame f, with the given result in x0, and
+// give the interrupts back to the host.
+static void switch_to_host(hvc_frame *f, u64 core, u64 result){
+  world *w = &(worlds[core][HOST]);
+  write_cnthp_ctl_el2(0);
+  *LOCAL_TIMER_IRQ_CNTL(core) &= ~LOCAL_TIMER_CNTHP_IRQ;
+  write_hcr_el2(read_hcr_el2() & ~(HCR_IMO | HCR_VI));
+  *f = w->frame;
+  f->x[0] = result;
+  load_el1(&(w->el1));
+  cores[core].running = false;
+}
+
+i64 guest_create(guest_info *g){
+  u64 core = smp_core_id();
+  core_state *c = &(cores[core]);
+  if(c->running || c->nb_guests == GUEST_MAX) return HVC_ERR_INVALID;
+  if(g->entry == 0 || g->stack_top % 16 != 0) return HVC_ERR_INVALID;
+
+  world *w = &(worlds[core][c->nb_guests]);
+  for(u64 i = 0; i < 31; i++) w->frame.x[i] = 0;
+  w->frame.x[0] = g->arg;
+  w->frame.x[30] = (u64) guest_exit;
+  w->frame.elr = g->entry;
+  w->frame.spsr = GUEST_SPSR;
+  w->frame.pad = 0;
+  w->el1.sp_el0 = g->stack_top - GUEST_EXCEPTION_STACK;
+  w->el1.sp_el1 = g->stack_top;
+  w->el1.vbar = (u64) guest_vector;
+  w->el1.elr = 0;
+  w->el1.spsr = 0;
+  w->el1.esr = 0;
+  w->el1.far = 0;
+  // Guests start with the values of the host (e.g., the per-core data of the
+  // kernel functions they run), but their changes are kept to themselves.
+  w->el1.tpidr_el0 = read_tpidr_el0();
+  w->el1.tpidr_el1 = read_tpidr_el1();
+  w->el1.cntkctl = read_cntkctl_el1();
+  w->state = GUEST_READY;
+  w->info = g;
+
+  g->state = GUEST_READY;
+  g->result = 0;
+  g->cpu_ticks = 0;
+  g->nb_slices = 0;
+  g->nb_virqs = 0;
+  return (i64) c->nb_guests++;
+}
+
+bool guest_reset(){
+  core_state *c = &(cores[smp_core_id()]);
+  if(c->running) return false;
+  c->nb_guests = 0;
+  c->current = 0;
+  c->stats.nb_switches = 0;
+  c->stats.latency_ticks = 0;
+  c->stats.max_latency = 0;
+  c->stats.nb_preempted = 0;
+  return true;
+}
+
+bool guest_hvc(hvc_frame *f){
+  u64 core = smp_core_id();
+  core_state *c = &(cores[core]);
+
+  if(f->x[0] == HVC_GUEST_RUN){
+    if(c->running || f->x[1] == 0){
+      f->x[0] = (u64) HVC_ERR_INVALID;
+      return true;
+    }
+    u64 next = next_guest(core, c->current);
+    if(next == HOST){
+      f->x[0] = 0;
+      return true;
+    }
+    c->slice = f->x[1] * read_cntfrq_el0() / 1000000;
+    if(c->slice == 0) c->slice = 1;
+
+    // Save the host, and take the interrupts (including the one of the CNTHP
+    // timer) until it is resumed.
+    worlds[core][HOST].frame = *f;
+    save_el1(&(worlds[core][HOST].el1));
+    *LOCAL_TIMER_IRQ_CNTL(core) |= LOCAL_TIMER_CNTHP_IRQ;
+    c->running = true;
+    switch_in(f, core, next);
+    return true;
+  }
+
+  if(f->x[0] == HVC_GUEST_EXIT){
+    if(!c->running){
+      f->x[0] = (u64) HVC_ERR_INVALID;
+      return true;
+    }
+    world *w = &(worlds[core][c->current]);
+    w->state = f->x[2] ? GUEST_FAULTED : GUEST_EXITED;
+    w->info->result = f->x[1];
+    w->info->state = w->state;
+    switch_out(f, core);
+
+    u64 next = next_guest(core, c->current);
+    if(next == HOST){
+      switch_to_host(f, core, 0);
+    } else {
+      switch_in(f, core, next);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+i64 guest_ack(){
+  core_state *c = &(cores[smp_core_id()]);
+  if(!c->running) return HVC_ERR_INVALID;
+  write_hcr_el2(read_hcr_el2() & ~HCR_VI);
+  worlds[smp_core_id()][c->current].info->nb_virqs++;
+  return 0;
+}
+
+void guest_irq(hvc_frame *f){
+  u64 core = smp_core_id();
+  core_state *c = &(cores[core]);
+  if(!c->running) return;
+
+  u64 deadline = read_cnthp_cval_el2();
+  u32 sources = *LOCAL_IRQ_SOURCE(core);
+  switch_out(f, core);
+
+  // Interrupts of the host are handled by the host: the guests are resumed
+  // with the next HVC_GUEST_RUN, which gets the number of runnable guests.
+  if(sources & ~LOCAL_IRQ_CNTHP){
+    c->stats.nb_preempted++;
+    switch_to_host(f, core, nb_ready(core));
+    return;
+  }
+
+  // End of the slice: switch to the next guest (the current one is runnable).
+  switch_in(f, core, next_guest(core, c->current));
+  u64 latency = counter_ticks() - deadline;
+  c->stats.nb_switches++;
+  c->stats.latency_ticks += latency;
+  if(latency > c->stats.max_latency) c->stats.max_latency = latency;
+}
+
+void guest_get_switch_stats(guest_switch_stats *s){
+  *s = cores[smp_core_id()].stats;
+}
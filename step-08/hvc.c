@@ -0,0 +1,263 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <macros.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <kernel/guest.h>
+#include <kernel/hvc.h>
+#include <kernel/mmiotrace.h>
+#include <kernel/prof.h>
+#include <kernel/smp.h>
+#include <kernel/stage2.h>
+#include <kernel/vuart.h>
+
+// Note: the functions of this file run at EL2.
+
+// Exception classes (bits 31:26 of ESR_EL2).
+#define ESR_EC_HVC64    0x16 // "hvc" instruction in aarch64.
+#define ESR_EC_DABT_LOW 0x24 // Data abort from EL1.
+
+// RAM of EL1 (below the BCM2837 peripherals).
+#define EL1_RAM_END 0x3f000000ULL
+
+// Memory private to EL2 (defined in "kernel8.ld").
+extern char __hyp_start[];
+extern char __hyp_end[];
+
+// Stacks used at EL2 (SP_EL2), one per core (in the memory private to EL2, see
+// "kernel/stage2.h"), and their tops (used by the code of "boot.S", which is
+// run before any C code).
+static u8 stacks[NB_CORES][HVC_STACK_SIZE]
+  __attribute__((aligned(4096), section(".hyp")));
+_Static_assert(NB_CORES == 4, "one stack top per core below");
+u8 *const hvc_stack_tops[NB_CORES] = {
+  stacks[0] + HVC_STACK_SIZE,
+  stacks[1] + HVC_STACK_SIZE,
+  stacks[2] + HVC_STACK_SIZE,
+  stacks[3] + HVC_STACK_SIZE
+};
+
+// Counter only modified at EL2. It is sharded into one counter per core (on
+// its own cache line), only modified by that core, and merged on read.
+typedef struct {
+  volatile u64 value;
+} __attribute__((aligned(64))) counter_shard;
+
+static counter_shard secret_counter[NB_CORES]
+  __attribute__((section(".hyp")));
+
+// Ring of operations of each core (NULL if not set up), kept in the memory
+// private to EL2 like the counter, so that EL1 cannot change them.
+static hvc_ring *rings[NB_CORES] __attribute__((section(".hyp")));
+
+// Indicates whether the buffer of n entries of size bytes at addr (given by
+// EL1) can be written by EL2: it must be 8-byte aligned, in the RAM of EL1, and
+// outside of the memory private to EL2.
+static bool el1_buffer_ok(u64 addr, u64 n, u64 size){
+  if(addr % 8 != 0 || addr >= EL1_RAM_END) return false;
+  if(n > (EL1_RAM_END - addr) / size) return false;
+  u64 end = addr + n * size;
+  return end <= (u64) __hyp_start || addr >= (u64) __hyp_end;
+}
+
+static i64 hvc_null(u64 *x){
+  UNUSED(x);
+  return 0;
+}
+
+static i64 hvc_counter_inc(u64 *x){
+  UNUSED(x);
+  secret_counter[smp_core_id()].value++;
+  return 0;
+}
+
+static i64 hvc_counter_get(u64 *x){
+  UNUSED(x);
+  u64 sum = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    sum += secret_counter[core].value;
+  }
+  return (i64) sum;
+}
+
+static i64 hvc_ring_setup_handler(u64 *x){
+  if(x[1] % 64 != 0 || !el1_buffer_ok(x[1], 1, sizeof(hvc_ring))){
+    return HVC_ERR_INVALID;
+  }
+  rings[smp_core_id()] = (hvc_ring *) x[1];
+  return 0;
+}
+
+static i64 hvc_ring_submit_handler(u64 *x);
+
+static i64 hvc_s2_stats(u64 *x){
+  stage2_stats s;
+  stage2_get_stats(&s);
+  x[1] = s.nb_permission;
+  x[2] = s.nb_unemulated;
+  x[3] = s.nb_split;
+  return (i64) s.nb_translation;
+}
+
+static i64 hvc_s2_last(u64 *x){
+  UNUSED(x);
+  return (i64) stage2_last_fault();
+}
+
+static i64 hvc_vuart_stats(u64 *x){
+  vuart_stats s;
+  vuart_get_stats(&s);
+  x[1] = s.nb_chars;
+  x[2] = s.nb_batches;
+  x[3] = s.max_batch;
+  return (i64) s.nb_traps;
+}
+
+static i64 hvc_vuart_ctl(u64 *x){
+  if(x[1] == VUART_STATE) return vuart_emulating() ? 1 : 0;
+  return vuart_ctl(x[1]) ? 0 : HVC_ERR_INVALID;
+}
+
+static i64 hvc_guest_add(u64 *x){
+  // The descriptor is kept, and updated by EL2 while the guest runs.
+  if(!el1_buffer_ok(x[1], 1, sizeof(guest_info))) return HVC_ERR_INVALID;
+  return guest_create((guest_info *) x[1]);
+}
+
+static i64 hvc_guest_ack(u64 *x){
+  UNUSED(x);
+  return guest_ack();
+}
+
+static i64 hvc_guest_stats(u64 *x){
+  guest_switch_stats s;
+  guest_get_switch_stats(&s);
+  x[1] = s.latency_ticks;
+  x[2] = s.max_latency;
+  x[3] = s.nb_preempted;
+  return (i64) s.nb_switches;
+}
+
+static i64 hvc_guest_reset(u64 *x){
+  UNUSED(x);
+  return guest_reset() ? 0 : HVC_ERR_INVALID;
+}
+
+static i64 hvc_prof_start(u64 *x){
+  return prof_start(x[1]) ? 0 : HVC_ERR_INVALID;
+}
+
+static i64 hvc_prof_stop(u64 *x){
+  UNUSED(x);
+  prof_stop();
+  return 0;
+}
+
+static i64 hvc_prof_read(u64 *x){
+  if(x[1] >= NB_CORES || !el1_buffer_ok(x[2], x[3], sizeof(prof_sample))){
+    return HVC_ERR_INVALID;
+  }
+  u64 n = prof_read(x[1], (prof_sample *) x[2], x[3], &(x[1]), &(x[2]));
+  return (i64) n;
+}
+
+static i64 hvc_mmio_ctl(u64 *x){
+  return mmiotrace_ctl(x[1]) ? 0 : HVC_ERR_INVALID;
+}
+
+static i64 hvc_mmio_sites(u64 *x){
+  if(x[1] >= NB_CORES || !el1_buffer_ok(x[2], x[3], sizeof(mmiotrace_site))){
+    return HVC_ERR_INVALID;
+  }
+  u64 n = mmiotrace_read_sites(x[1], (mmiotrace_site *) x[2], x[3]);
+  mmiotrace_stats s;
+  mmiotrace_get_stats(x[1], &s);
+  x[1] = s.nb_traps;
+  x[2] = s.nb_dropped;
+  x[3] = s.stopped_pc;
+  return (i64) n;
+}
+
+static i64 hvc_mmio_log(u64 *x){
+  if(x[1] >= NB_CORES ||
+     !el1_buffer_ok(x[2], x[3], sizeof(mmiotrace_access))){
+    return HVC_ERR_INVALID;
+  }
+  return (i64) mmiotrace_read_log(x[1], (mmiotrace_access *) x[2], x[3]);
+}
+
+// Jump table, indexed by function ID. HVC_GUEST_RUN and HVC_GUEST_EXIT switch
+// worlds, and are handled directly on the frame (so they cannot be batched).
+static const hvc_fn handlers[NB_HVC] = {
+  [HVC_NULL]        = hvc_null,
+  [HVC_COUNTER_INC] = hvc_counter_inc,
+  [HVC_COUNTER_GET] = hvc_counter_get,
+  [HVC_RING_SETUP]  = hvc_ring_setup_handler,
+  [HVC_RING_SUBMIT] = hvc_ring_submit_handler,
+  [HVC_S2_STATS]    = hvc_s2_stats,
+  [HVC_S2_LAST]     = hvc_s2_last,
+  [HVC_VUART_STATS] = hvc_vuart_stats,
+  [HVC_VUART_CTL]   = hvc_vuart_ctl,
+  [HVC_GUEST_ADD]   = hvc_guest_add,
+  [HVC_GUEST_ACK]   = hvc_guest_ack,
+  [HVC_GUEST_STATS] = hvc_guest_stats,
+  [HVC_GUEST_RESET] = hvc_guest_reset,
+  [HVC_PROF_START]  = hvc_prof_start,
+  [HVC_PROF_STOP]   = hvc_prof_stop,
+  [HVC_PROF_READ]   = hvc_prof_read,
+  [HVC_MMIO_CTL]    = hvc_mmio_ctl,
+  [HVC_MMIO_SITES]  = hvc_mmio_sites,
+  [HVC_MMIO_LOG]    = hvc_mmio_log
+};
+
+// Run the handler for function ID x[0].
+static i64 call(u64 *x){
+  u64 id = x[0];
+  if(id >= NB_HVC || handlers[id] == NULL) return HVC_ERR_UNKNOWN;
+  return handlers[id](x);
+}
+
+static i64 hvc_ring_submit_handler(u64 *x){
+  UNUSED(x);
+  hvc_ring *r = rings[smp_core_id()];
+  if(r == NULL) return HVC_ERR_INVALID;
+
+  // The tail is read once, so that EL1 cannot make us loop forever.
+  u64 head = r->head;
+  u64 tail = r->tail;
+  if(tail - head > HVC_RING_SIZE) return HVC_ERR_INVALID;
+
+  for(u64 i = head; i != tail; i++){
+    hvc_op *op = &(r->ops[i % HVC_RING_SIZE]);
+    u64 id = op->x[0];
+    if(id == HVC_RING_SETUP || id == HVC_RING_SUBMIT){
+      op->result = HVC_ERR_INVALID;
+    } else {
+      op->result = call(op->x);
+    }
+  }
+  r->head = tail;
+
+  return (i64) (tail - head);
+}
+
+// Synchronous exceptions taken to EL2 from EL1 (called from "boot.S"). Other
+// exceptions than hypercalls and stage-2 faults hang the core.
+void hvc_dispatch(hvc_frame *f){
+  u64 esr = read_esr_el2();
+  u64 ec = (esr >> 26) & 0x3f;
+
+  if(ec == ESR_EC_HVC64){
+    if(guest_hvc(f)) return;
+    f->x[0] = (u64) call(f->x);
+    return;
+  }
+  if(ec == ESR_EC_DABT_LOW){
+    if(vuart_data_abort(f, esr) || mmiotrace_data_abort(f, esr)) return;
+    if(stage2_data_abort(f, esr)) return;
+  }
+
+  while(1){
+    asm volatile("wfe");
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+
+// Atomic operations and memory barriers for aarch64 (ARMv8.0, no LSE).
+//
+// Note: exclusive accesses (ldxr/stxr) only work reliably on cacheable memory
+// on the Raspberry Pi 3, so these require the MMU and caches to be enabled.
+
+// Full data memory barrier for the inner shareable domain (all our cores).
+static inline void dmb_ish(void){
+  asm volatile("dmb ish" : : : "memory");
+}
+
+// Data synchronisation barrier for the inner shareable domain.
+static inline void dsb_ish(void){
+  asm volatile("dsb ish" : : : "memory");
+}
+
+// Signal an event to all cores. The "dsb" makes sure that prior stores are
+// visible to the other cores before they wake up.
+static inline void sev(void){
+  asm volatile("dsb ish; sev" : : : "memory");
+}
+
+// Wait for an event (or an interrupt) in low-power mode.
+static inline void wfe(void){
+  asm volatile("wfe" : : : "memory");
+}
+
+// Load the value at address p with acquire semantics.
+static inline u64 atomic_load_acquire(volatile u64 *p){
+  u64 v;
+  asm volatile("ldar %0, [%1]" : "=r" (v) : "r" (p) : "memory");
+  return v;
+}
+
+// Store v at address p with release semantics.
+static inline void atomic_store_release(volatile u64 *p, u64 v){
+  asm volatile("stlr %1, [%0]" : : "r" (p), "r" (v) : "memory");
+}
+
+// Atomically add v to the value at address p, and return the previous value.
+static inline u64 atomic_fetch_add(volatile u64 *p, u64 v){
+  u64 old, new;
+  u32 fail;
+  asm volatile(
+    "1: ldaxr %0, [%3]\n"
+    "   add %1, %0, %4\n"
+    "   stlxr %w2, %1, [%3]\n"
+    "   cbnz %w2, 1b\n"
+    : "=&r" (old), "=&r" (new), "=&r" (fail)
+    : "r" (p), "r" (v)
+    : "memory"
+  );
+  return old;
+}
+
+// Atomically replace the value at address p by desired if it is equal to the
+// expected value. Returns true on success, and false otherwise.
+static inline bool atomic_cas(volatile u64 *p, u64 expected, u64 desired){
+  u64 old;
+  u32 fail;
+  asm volatile(
+    "1: ldaxr %0, [%2]\n"
+    "   cmp %0, %3\n"
+    "   b.ne 2f\n"
+    "   stlxr %w1, %4, [%2]\n"
+    "   cbnz %w1, 1b\n"
+    "   b 3f\n"
+    "2: clrex\n"
+    "3:\n"
+    : "=&r" (old), "=&r" (fail)
+    : "r" (p), "r" (expected), "r" (desired)
+    : "cc", "memory"
+  );
+  return old == expected;
+}
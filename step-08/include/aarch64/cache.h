@@ -0,0 +1,17 @@
+#pragma once
+#include <types.h>
+
+// Size of a data cache line on the Cortex-A53 (in bytes).
+#define CACHE_LINE_SIZE 64
+
+// Clean and invalidate (to the point of coherency) the data cache lines with
+// data in the range of size bytes starting at addr.
+static inline void dcache_clean_inval_range(void *addr, u64 size){
+  u64 cur = (u64) addr & ~((u64) CACHE_LINE_SIZE - 1);
+  u64 end = (u64) addr + size;
+  while(cur < end){
+    asm volatile("dc civac, %0" : : "r" (cur) : "memory");
+    cur += CACHE_LINE_SIZE;
+  }
+  asm volatile("dsb sy" : : : "memory");
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <types.h>
+#include <aarch64/sysreg.h>
+
+// Performance monitors unit (PMU).
+//
+// Note: EL2 must allow EL1 to use the PMU (see MDCR_EL2 in "boot.S"). Event
+// counters are accessed through PMSELR_EL0, so the functions using them must
+// not be interrupted by code using them as well (see "kernel/perf.h").
+
+SYSREG_READ(pmcr_el0)
+SYSREG_WRITE(pmcr_el0)
+SYSREG_WRITE(pmcntenset_el0)
+SYSREG_WRITE(pmcntenclr_el0)
+SYSREG_READ(pmccntr_el0)
+SYSREG_WRITE(pmccfiltr_el0)
+SYSREG_READ(pmovsclr_el0)
+SYSREG_WRITE(pmovsclr_el0)
+SYSREG_WRITE(pmintenset_el1)
+SYSREG_WRITE(pmintenclr_el1)
+
+// Event counters are accessed through the one selected by PMSELR_EL0.
+SYSREG_READ(pmselr_el0)
+SYSREG_WRITE(pmselr_el0)
+SYSREG_WRITE(pmxevtyper_el0)
+SYSREG_READ(pmxevcntr_el0)
+SYSREG_WRITE(pmxevcntr_el0)
+
+// Access to the PMU from EL0.
+SYSREG_WRITE(pmuserenr_el0)
+
+// Bits of the PMCR_EL0 register.
+#define PMCR_E  (1ULL << 0) // Enable the counters.
+#define PMCR_LC (1ULL << 6) // The cycle counter overflows at 64 bits.
+
+// Number of event counters (field N of PMCR_EL0). At EL1, this is the number
+// of counters that are not reserved by EL2 (field HPMN of MDCR_EL2).
+#define PMCR_N(pmcr) (((pmcr) >> 11) & 0x1f)
+
+// Bits of the PMUSERENR_EL0 register: EL0 access to the PMU, and EL0 reads of
+// the cycle counter and of the event counters.
+#define PMUSERENR_EN (1ULL << 0)
+#define PMUSERENR_CR (1ULL << 2)
+#define PMUSERENR_ER (1ULL << 3)
+
+// Bit of the cycle counter in PMCNTENSET_EL0 (and similar registers).
+#define PMCNTEN_CYCLES (1ULL << 31)
+
+// Bit of PMCCFILTR_EL0 enabling the counting of cycles at EL2 (which are not
+// counted by default, EL0 and EL1 are).
+#define PMCCFILTR_NSH (1ULL << 27)
+
+// Fields of the PMEVTYPER<n>_EL0 registers: the event number, and the filters
+// (by default, events are counted at EL0 and EL1, but not at EL2).
+#define PMEVTYPER_EVENT(e) ((u64) (e) & 0x3ff)
+#define PMEVTYPER_NO_EL1   (1ULL << 31)
+#define PMEVTYPER_NO_EL0   (1ULL << 30)
+#define PMEVTYPER_EL2      (1ULL << 27)
+
+// Common events (all supported by the Cortex-A53).
+#define PMU_EVENT_L1I_CACHE_REFILL 0x01 // Instruction cache misses.
+#define PMU_EVENT_L1D_CACHE_REFILL 0x03 // Data cache misses.
+#define PMU_EVENT_L1D_CACHE        0x04 // Data cache accesses.
+#define PMU_EVENT_INST_RETIRED     0x08 // Instructions executed.
+#define PMU_EVENT_BR_MIS_PRED      0x10 // Mispredicted branches.
+#define PMU_EVENT_CPU_CYCLES       0x11 // Cycles.
+#define PMU_EVENT_BR_PRED          0x12 // Predictable branches.
+#define PMU_EVENT_L2D_CACHE        0x16 // L2 cache accesses.
+#define PMU_EVENT_L2D_CACHE_REFILL 0x17 // L2 cache misses.
+
+// Enable the PMU of the calling core: start the cycle counter, counting at
+// EL0, EL1 and EL2 (so that measurements include the time spent in
+// hypercalls), and let EL0 read counters. The event counters are started with
+// "pmu_counters_start".
+static inline void pmu_enable(void){
+  write_pmccfiltr_el0(PMCCFILTR_NSH);
+  write_pmcr_el0(read_pmcr_el0() | PMCR_E | PMCR_LC);
+  write_pmuserenr_el0(PMUSERENR_EN | PMUSERENR_CR | PMUSERENR_ER);
+  write_pmcntenset_el0(PMCNTEN_CYCLES);
+  isb();
+}
+
+// Number of CPU cycles counted by the calling core.
+static inline u64 pmu_cycles(void){
+  isb();
+  return read_pmccntr_el0();
+}
+
+// Number of event counters that can be used by the calling core.
+static inline u64 pmu_nb_counters(void){
+  return PMCR_N(read_pmcr_el0());
+}
+
+// Make event counter i (which must be stopped) count the given event at EL0,
+// EL1 and EL2 (as the cycle counter), from 0.
+static inline void pmu_counter_setup(u64 i, u64 event){
+  write_pmselr_el0(i);
+  isb();
+  write_pmxevtyper_el0(PMEVTYPER_EVENT(event) | PMEVTYPER_EL2);
+  write_pmxevcntr_el0(0);
+}
+
+// Value of event counter i (32-bit).
+static inline u64 pmu_counter_read(u64 i){
+  write_pmselr_el0(i);
+  isb();
+  return read_pmxevcntr_el0();
+}
+
+// Start (or stop) the event counters whose bits are set in mask.
+static inline void pmu_counters_start(u64 mask){
+  write_pmcntenset_el0(mask);
+  isb();
+}
+
+static inline void pmu_counters_stop(u64 mask){
+  write_pmcntenclr_el0(mask);
+  isb();
+}
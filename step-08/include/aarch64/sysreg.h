@@ -0,0 +1,110 @@
+#pragma once
+#include <types.h>
+
+// Accessors for the aarch64 system registers. Using SYSREG_READ(reg) defines a
+// function "read_reg" returning the value of system register "reg", and using
+// SYSREG_WRITE(reg) defines a function "write_reg" to set its value.
+//
+// Note: no ";" should follow uses of these macros (not allowed by -pedantic).
+
+#define SYSREG_READ(reg) \
+  static inline u64 read_##reg(void){ \
+    u64 v; \
+    asm volatile("mrs %0, " #reg : "=r" (v)); \
+    return v; \
+  }
+
+#define SYSREG_WRITE(reg) \
+  static inline void write_##reg(u64 v){ \
+    asm volatile("msr " #reg ", %0" : : "r" (v) : "memory"); \
+  }
+
+// Identification.
+SYSREG_READ(mpidr_el1)
+
+// Software thread ID register (used for per-core data, see "kernel/percpu.h").
+SYSREG_READ(tpidr_el1)
+SYSREG_WRITE(tpidr_el1)
+SYSREG_READ(tpidr_el0)
+SYSREG_WRITE(tpidr_el0)
+
+// Generic timer (counter and its frequency).
+SYSREG_READ(cntpct_el0)
+SYSREG_READ(cntfrq_el0)
+SYSREG_READ(cntkctl_el1)
+SYSREG_WRITE(cntkctl_el1)
+SYSREG_READ(cntp_ctl_el0)
+SYSREG_WRITE(cntp_ctl_el0)
+SYSREG_WRITE(cntp_tval_el0)
+SYSREG_READ(cntp_cval_el0)
+SYSREG_WRITE(cntp_cval_el0)
+SYSREG_WRITE(cntv_ctl_el0)
+SYSREG_READ(cntv_cval_el0)
+SYSREG_WRITE(cntv_cval_el0)
+
+// Hypervisor (EL2) physical timer.
+SYSREG_WRITE(cnthp_ctl_el2)
+SYSREG_WRITE(cnthp_tval_el2)
+SYSREG_READ(cnthp_cval_el2)
+
+// Exception handling at EL1.
+SYSREG_READ(vbar_el1)
+SYSREG_WRITE(vbar_el1)
+SYSREG_READ(esr_el1)
+SYSREG_WRITE(esr_el1)
+SYSREG_READ(far_el1)
+SYSREG_WRITE(far_el1)
+SYSREG_READ(elr_el1)
+SYSREG_WRITE(elr_el1)
+SYSREG_READ(spsr_el1)
+SYSREG_WRITE(spsr_el1)
+SYSREG_READ(daif)
+
+// Stack pointers of EL0 and EL1 (only accessible from a higher EL).
+SYSREG_READ(sp_el0)
+SYSREG_WRITE(sp_el0)
+SYSREG_READ(sp_el1)
+SYSREG_WRITE(sp_el1)
+
+// Exception handling at EL2.
+SYSREG_READ(esr_el2)
+SYSREG_READ(far_el2)
+SYSREG_READ(hpfar_el2)
+
+// Hypervisor configuration and stage-2 translation.
+SYSREG_READ(hcr_el2)
+SYSREG_WRITE(hcr_el2)
+SYSREG_READ(mdcr_el2)
+SYSREG_WRITE(mdcr_el2)
+SYSREG_WRITE(vtcr_el2)
+SYSREG_WRITE(vttbr_el2)
+
+// EL1 translation regime.
+SYSREG_READ(sctlr_el1)
+SYSREG_WRITE(sctlr_el1)
+SYSREG_WRITE(tcr_el1)
+SYSREG_WRITE(mair_el1)
+SYSREG_WRITE(ttbr0_el1)
+
+// EL2 translation regime.
+SYSREG_WRITE(sctlr_el2)
+SYSREG_WRITE(tcr_el2)
+SYSREG_WRITE(mair_el2)
+SYSREG_WRITE(ttbr0_el2)
+
+// Bits of the SCTLR_ELx registers.
+#define SCTLR_M (1ULL << 0)  // MMU enable.
+#define SCTLR_C (1ULL << 2)  // Data cache enable.
+#define SCTLR_I (1ULL << 12) // Instruction cache enable.
+
+// Instruction synchronisation barrier.
+static inline void isb(void){
+  asm volatile("isb" : : : "memory");
+}
+
+// Read the generic timer's physical counter (which ticks at the frequency given
+// by CNTFRQ_EL0). The "isb" prevents the read from being performed early.
+static inline u64 counter_ticks(void){
+  isb();
+  return read_cntpct_el0();
+}
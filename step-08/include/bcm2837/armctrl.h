@@ -0,0 +1,32 @@
+#pragma once
+#include <bits.h>
+#include <bcm2837/register.h>
+
+// Interrupt controller of the BCM2835 "ARM control" block (chapter 7 of the
+// BCM2835 peripheral specification). It gathers the 64 GPU peripheral IRQs,
+// and 8 ARM-specific IRQs (basic IRQs), and signals them to the ARM local
+// interrupt controller (as the "GPU" IRQ source, see "bcm2837/local.h").
+#define IRQ_BASIC_PENDING bus_to_reg32(0x7e00b200ULL)
+#define IRQ_PENDING_1     bus_to_reg32(0x7e00b204ULL)
+#define IRQ_PENDING_2     bus_to_reg32(0x7e00b208ULL)
+#define FIQ_CONTROL       bus_to_reg32(0x7e00b20cULL)
+#define ENABLE_IRQS_1     bus_to_reg32(0x7e00b210ULL)
+#define ENABLE_IRQS_2     bus_to_reg32(0x7e00b214ULL)
+#define ENABLE_BASIC_IRQS bus_to_reg32(0x7e00b218ULL)
+#define DISABLE_IRQS_1    bus_to_reg32(0x7e00b21cULL)
+#define DISABLE_IRQS_2    bus_to_reg32(0x7e00b220ULL)
+#define DISABLE_BASIC_IRQS bus_to_reg32(0x7e00b224ULL)
+
+// Bits 0 to 7 of IRQ_BASIC_PENDING (and of the basic enable/disable registers)
+// are the ARM-specific IRQs.
+#define IRQ_BASIC_ARM_MASK MASK_U32(0, 8)
+
+// Some of the GPU IRQs (numbered from 0 to 63).
+#define GPU_IRQ_SYSTEM_TIMER_1 1
+#define GPU_IRQ_SYSTEM_TIMER_3 3
+#define GPU_IRQ_AUX            29
+#define GPU_IRQ_GPIO_0         49
+#define GPU_IRQ_GPIO_1         50
+#define GPU_IRQ_GPIO_2         51
+#define GPU_IRQ_GPIO_3         52
+#define GPU_IRQ_UART           57
@@ -1,4 +1,5 @@
 #pragma once
+#include <types.h>
 #include <bcm2837/register.h>
 
 // GPIO registers
@@ -59,3 +60,51 @@
 #define GPPUD_OFF       0
 #define GPPUD_PULL_DOWN 1
 #define GPPUD_PULL_UP   2
+
+// Number of GPIO pins. Sets of pins are given as masks (bit i for pin i), so
+// that bank 0 (pins 0 to 31) is the low word, and bank 1 the high word.
+#define GPIO_NB_PINS 54
+
+// Setup time for the GPIO pull-up/down control signals: the specification asks
+// for 150 cycles (of the 250MHz core clock), i.e. 600ns, which we round up.
+#define GPPUD_SETUP_NS 1000
+
+// Note: the function select registers are cached, so that they are only read
+// once, and only written when a function changes. All accesses to them must
+// thus go through this API, and configuration functions must not be called
+// concurrently by several cores.
+
+// Set the function (one of the GPFSEL_* constants) of the given pin, or of all
+// the pins of mask (with a single write per function select register).
+void gpio_set_function(u64 pin, u32 fsel);
+void gpio_set_function_mask(u64 mask, u32 fsel);
+
+// Function (one of the GPFSEL_* constants) of the given pin.
+u32 gpio_get_function(u64 pin);
+
+// Set the pull-up/down configuration (one of the GPPUD_* constants) of all the
+// pins of mask, following the GPPUD / GPPUDCLK sequence of the specification.
+void gpio_pull(u64 mask, u32 pud);
+
+// Drive high (or low) all the output pins of mask, with a single write to
+// GPSET0 (or GPCLR0) for each bank that has pins in mask.
+static inline void gpio_set(u64 mask){
+  if((u32) mask) *GPSET0 = (u32) mask;
+  if(mask >> 32) *GPSET1 = (u32) (mask >> 32);
+}
+
+static inline void gpio_clear(u64 mask){
+  if((u32) mask) *GPCLR0 = (u32) mask;
+  if(mask >> 32) *GPCLR1 = (u32) (mask >> 32);
+}
+
+// Drive the output pins of mask to the corresponding bits of values.
+static inline void gpio_write(u64 mask, u64 values){
+  gpio_set(mask & values);
+  gpio_clear(mask & ~values);
+}
+
+// Levels of all the pins.
+static inline u64 gpio_read(){
+  return *GPLEV0 | ((u64) *GPLEV1 << 32);
+}
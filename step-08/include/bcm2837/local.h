@@ -0,0 +1,53 @@
+#pragma once
+#include <bits.h>
+#include <types.h>
+
+// Registers for the ARM local peripherals (interrupt routing for the cores,
+// mailboxes, local timer), documented in the BCM2836 "QA7" specification.
+//
+// Note: these are not behind the peripheral bus, and are directly mapped at
+// physical address 0x40000000.
+
+// Convert an offset in the local peripherals block into a register pointer.
+#define local_reg32(off) ((volatile u32 *) (0x40000000ULL + (off)))
+
+// Global control registers.
+#define LOCAL_CONTROL         local_reg32(0x00)
+#define LOCAL_PRESCALER       local_reg32(0x08)
+#define LOCAL_GPU_IRQ_ROUTING local_reg32(0x0c)
+#define LOCAL_PMU_IRQ_SET     local_reg32(0x10)
+#define LOCAL_PMU_IRQ_CLR     local_reg32(0x14)
+
+// Per-core registers (core from 0 to 3).
+#define LOCAL_TIMER_IRQ_CNTL(core)   local_reg32(0x40 + 4 * (core))
+#define LOCAL_MAILBOX_IRQ_CNTL(core) local_reg32(0x50 + 4 * (core))
+#define LOCAL_IRQ_SOURCE(core)       local_reg32(0x60 + 4 * (core))
+#define LOCAL_FIQ_SOURCE(core)       local_reg32(0x70 + 4 * (core))
+
+// Mailboxes (four per core): writing sets bits, and reading from the second
+// register gives the value, while writing to it clears bits.
+#define LOCAL_MAILBOX_SET(core, mb)   local_reg32(0x80 + 16 * (core) + 4 * (mb))
+#define LOCAL_MAILBOX_RDCLR(core, mb) local_reg32(0xc0 + 16 * (core) + 4 * (mb))
+
+// Bit fields of the LOCAL_PMU_IRQ_SET and LOCAL_PMU_IRQ_CLR registers (routing
+// of the PMU interrupt of each core, as an IRQ or as a FIQ).
+#define LOCAL_PMU_IRQ(core) BIT_U32(core)
+#define LOCAL_PMU_FIQ(core) BIT_U32(4 + (core))
+
+// Bit fields of the LOCAL_TIMER_IRQ_CNTL registers (IRQ enable for each of the
+// generic timer interrupts, bits 4 to 7 are the same for FIQs).
+#define LOCAL_TIMER_CNTPS_IRQ  BIT_U32(0) // Secure physical timer.
+#define LOCAL_TIMER_CNTPNS_IRQ BIT_U32(1) // Non-secure physical timer.
+#define LOCAL_TIMER_CNTHP_IRQ  BIT_U32(2) // Hypervisor timer.
+#define LOCAL_TIMER_CNTV_IRQ   BIT_U32(3) // Virtual timer.
+
+// Bit fields of the LOCAL_IRQ_SOURCE (and LOCAL_FIQ_SOURCE) registers.
+#define LOCAL_IRQ_CNTPS       BIT_U32(0)
+#define LOCAL_IRQ_CNTPNS      BIT_U32(1)
+#define LOCAL_IRQ_CNTHP       BIT_U32(2)
+#define LOCAL_IRQ_CNTV        BIT_U32(3)
+#define LOCAL_IRQ_MAILBOX(mb) BIT_U32(4 + (mb))
+#define LOCAL_IRQ_GPU         BIT_U32(8)
+#define LOCAL_IRQ_PMU         BIT_U32(9)
+#define LOCAL_IRQ_AXI         BIT_U32(10)
+#define LOCAL_IRQ_LOCAL_TIMER BIT_U32(11)
@@ -0,0 +1,15 @@
+#pragma once
+#include <bcm2837/register.h>
+
+// System timer registers (chapter 12 of the BCM2835 peripheral specification).
+// The free-running counter (CHI:CLO) ticks at 1MHz.
+#define SYSTIMER_CS  bus_to_reg32(0x7e003000ULL)
+#define SYSTIMER_CLO bus_to_reg32(0x7e003004ULL)
+#define SYSTIMER_CHI bus_to_reg32(0x7e003008ULL)
+#define SYSTIMER_C0  bus_to_reg32(0x7e00300cULL)
+#define SYSTIMER_C1  bus_to_reg32(0x7e003010ULL)
+#define SYSTIMER_C2  bus_to_reg32(0x7e003014ULL)
+#define SYSTIMER_C3  bus_to_reg32(0x7e003018ULL)
+
+// Frequency of the system timer counter (in Hz).
+#define SYSTIMER_FREQ 1000000ULL
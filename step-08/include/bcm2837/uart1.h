@@ -6,11 +6,17 @@
 void uart1_init();
 
 // Important note: the following operations are blocking if the UART1 internal
-// (input or output) buffer is full.
+// (input or output) buffer is full. When a console core is running, output is
+// queued for that core instead (see "kernel/console.h"), and the output
+// operations only block if the queue of the calling core is full.
 
 // Write character c to UART1.
 void uart1_putc(char c);
 
+// Write character c to UART1 directly, even if a console core is running (see
+// "kernel/console.h"). This is used by the console core itself.
+void uart1_raw_putc(char c);
+
 // Write the null-terminated string s to UART1.
 // Note: the character "\n" is written as the sequence "\r\n".
 void uart1_puts(const char *s);
@@ -23,7 +29,8 @@ void uart1_puts(const char *s);
 // - "%b": print the hexadecimal representation of the given character,
 // - "%w": print the hexadecimal representation of the given word (u64),
 // - "%h": print the hexadecimal representation of the given half-word (u34),
-// - "%i": print the decimal representation of the given integer (int).
+// - "%i": print the decimal representation of the given integer (int),
+// - "%u": print the decimal representation of the given word (u64).
 void uart1_printf(const char *format, ...);
 
 // Read a character from UART1.
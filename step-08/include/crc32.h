@@ -0,0 +1,21 @@
+#pragma once
+#include <types.h>
+
+// CRC-32 (as used by zlib, Ethernet, ...), computed bytewise using a table.
+
+// Build the lookup table: must be called before other "crc32_*" functions.
+void crc32_init();
+
+// Update the CRC crc (initially 0) with the len bytes at buf.
+u32 crc32_update(u32 crc, const u8 *buf, u64 len);
+
+// Compute the CRC of the concatenation of two buffers from their CRCs, crc1
+// and crc2, given the length of the second buffer. (Same as zlib.)
+u32 crc32_combine(u32 crc1, u32 crc2, u64 len2);
+
+// The above requires a fair amount of computation that only depends on len2.
+// When combining many CRCs for buffers of the same length, it is better to
+// first compute an operator (32 words) for the length using the following,
+// and then to combine pairs of CRCs with "crc32_combine_op".
+void crc32_combine_gen(u32 *op, u64 len2);
+u32 crc32_combine_op(const u32 *op, u32 crc1, u32 crc2);
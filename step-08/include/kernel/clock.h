@@ -0,0 +1,37 @@
+#pragma once
+#include <types.h>
+
+// Clock source and delays.
+//
+// Time is read from the physical counter of the generic timer (CNTPCT_EL0, at
+// the frequency given by CNTFRQ_EL0). If the generic timer is not usable (its
+// frequency was not set up by the firmware, or its counter does not run), the
+// BCM2835 system timer (at 1MHz) is used instead. Delays that are shorter than
+// two ticks of the clock source rely on a busy-wait loop calibrated against it.
+//
+// Note: the clock is initialised on first use, so these functions can be used
+// very early (even before the UART is initialised).
+
+// Possible clock sources.
+#define CLOCK_GENERIC_TIMER 0
+#define CLOCK_SYSTEM_TIMER  1
+
+// Select and calibrate the clock source (done automatically on first use).
+void clock_init();
+
+// Selected clock source (one of the CLOCK_* constants), and its frequency.
+u64 clock_source();
+u64 clock_freq();
+
+// Number of iterations of the calibrated delay loop per millisecond.
+u64 clock_loops_per_ms();
+
+// Current value of the clock source counter.
+u64 clock_ticks();
+
+// Time (in nanoseconds) since the clock source started counting.
+u64 now_ns();
+
+// Busy-wait for at least the given number of nanoseconds (or microseconds).
+void ndelay(u64 ns);
+void udelay(u64 us);
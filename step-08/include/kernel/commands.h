@@ -1,4 +1,6 @@
 #pragma once
+#include <stddef.h>
+#include <types.h>
 
 // Structure describing an availalbe "command".
 typedef struct __cmd_descr {
@@ -16,3 +18,11 @@ typedef struct __cmd_descr {
 // Array of all available commands (defined in "commands.c").
 // It is terminated by a dummy entry whose fields are all NULL pointers.
 extern cmd_descr cmds[];
+
+// Find the command with the given name (or return NULL if there is none).
+cmd_descr *cmd_find(const char *name);
+
+// Commands measuring a throughput can report the amount of work they did on
+// the calling core (in units of their choice, e.g., bytes) using this function.
+// This is used by the "smp" command to compute aggregate throughputs.
+void cmd_report_work(u64 units);
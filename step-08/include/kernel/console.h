@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+
+// Console core: an optional mode in which a secondary core owns the UART.
+//
+// When the console core is running, UART output functions ("uart1_putc",
+// "uart1_puts" and "uart1_printf") do not write to the UART themselves: they
+// push output records (with a timestamp) into a lock-free queue of the calling
+// core, and return immediately (unless the queue is full). The console core
+// merges the records of all queues in timestamp order, and writes them out.
+//
+// Note: input ("uart1_getc") is not affected.
+
+// Maximum number of characters in a record (longer output is split).
+#define CONSOLE_RECORD_TEXT 112
+
+// Start the console core on the given (secondary, online and idle) core.
+// Returns false if that is not possible, or if the console is already running.
+bool console_start(u64 core);
+
+// Stop the console core, after it has written all pending records. The other
+// cores should not be producing output concurrently.
+void console_stop();
+
+// Indicates whether the console core is running.
+bool console_enabled();
+
+// Core running the console (only meaningful if "console_enabled").
+u64 console_core();
+
+// Queue the len characters of s for output (split into records as needed).
+void console_write(const char *s, u64 len);
+
+// Number of records written by the console core since it was started, and the
+// number of times a producer had to wait for space in its queue.
+u64 console_nb_records();
+u64 console_nb_full();
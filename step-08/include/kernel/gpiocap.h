@@ -0,0 +1,58 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <bcm2837/gpio.h>
+
+// Timestamped capture of GPIO edges.
+//
+// Edge detection is enabled on selected pins, and the GPIO interrupt handler
+// (run on core 0, where GPU IRQs are routed) stamps each detected edge with the
+// value of CNTPCT_EL0 at the entry of the IRQ dispatcher, and pushes it into a
+// lock-free ring. Events are consumed by a single reader (on any core), with
+// "gpiocap_pop". When the ring is full, new events are dropped (and counted).
+//
+// Synchronous detection samples the pins with the system clock, and filters
+// out glitches. Asynchronous detection (GPAREN / GPAFEN) does not, and can be
+// used for signals with very short pulses.
+//
+// Note: when both edges are captured on a pin, the direction of an edge is
+// deduced from the level of the pin in the handler, so it is only reliable if
+// the signal does not change again before the interrupt is handled.
+
+// Number of GPIO pins.
+#define GPIOCAP_NB_PINS GPIO_NB_PINS
+
+// Capacity of the ring (number of events).
+#define GPIOCAP_RING_SIZE 4096
+
+// Flags for "gpiocap_enable".
+#define GPIOCAP_RISING  (1ULL << 0) // Capture rising edges.
+#define GPIOCAP_FALLING (1ULL << 1) // Capture falling edges.
+#define GPIOCAP_ASYNC   (1ULL << 2) // Use asynchronous edge detection.
+
+// A captured edge.
+typedef struct {
+  u64 time; // Value of CNTPCT_EL0 when the interrupt was taken.
+  u32 pin;  // GPIO pin.
+  u32 edge; // Either GPIOCAP_RISING or GPIOCAP_FALLING.
+} gpiocap_event;
+
+// Configure the given pin as an input, and capture the edges selected by flags
+// (installing the interrupt handler if needed). Returns false if the pin is
+// invalid, reserved (UART1 pins), or if no edge is selected.
+bool gpiocap_enable(u64 pin, u64 flags);
+
+// Stop capturing edges on the given pin.
+void gpiocap_disable(u64 pin);
+
+// Stop capturing edges on all pins, and discard the events of the ring.
+void gpiocap_reset();
+
+// Pop the oldest event of the ring into e. Returns false if the ring is empty.
+// This must only be called by one thread at a time.
+bool gpiocap_pop(gpiocap_event *e);
+
+// Number of events captured (including dropped ones), and dropped because the
+// ring was full.
+u64 gpiocap_nb_events();
+u64 gpiocap_nb_dropped();
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/hvc.h>
+
+// Guests: EL1 programs time-sliced by EL2 on a core.
+//
+// A guest is an EL1 entry point (taking one argument) with its own stack. It
+// is created by the kernel (the host) with the HVC_GUEST_ADD hypercall, and
+// run with the HVC_GUEST_RUN hypercall: EL2 then saves the state of the host,
+// and switches between the runnable guests of the core (round robin), until
+// they all have exited (by returning from their entry point), or until an
+// interrupt of the host is pending. HVC_GUEST_RUN then returns the number of
+// runnable guests (0 when they have all exited), and it should be issued with
+// interrupts unmasked, so that the host can handle its pending interrupt before
+// issuing it again. Guests only run on the core that created them, and each
+// core has its own guests.
+//
+// Scheduling uses the hypervisor timer (CNTHP), whose interrupt is taken to
+// EL2 while guests run (HCR_EL2.IMO). On each slice, a virtual interrupt is
+// injected into the guest (HCR_EL2.VI), which it acknowledges with the
+// HVC_GUEST_ACK hypercall from its exception vector (see "guest.S").
+//
+// The state of a guest is its registers (x0 to x30, PC and PSTATE), the EL1
+// exception handling registers (stack pointers, VBAR_EL1, ELR_EL1, SPSR_EL1,
+// ESR_EL1 and FAR_EL1), the thread ID registers (TPIDR_EL0 and TPIDR_EL1,
+// initially those of the host) and CNTKCTL_EL1.
+//
+// Guests are not isolated from the host: they share its memory, its EL1
+// translation regime (SCTLR_EL1, TTBR0_EL1, TCR_EL1, ..., and the stage-1
+// tables) and its stage-2 tables, so their code and stacks are part of the
+// kernel, and they must not change the other system registers.
+//
+// Note: the functions of this module run at EL2 (unless stated otherwise).
+
+// Maximum number of guests per core.
+#define GUEST_MAX 4
+
+// Size of the top part of a guest stack used for exceptions (SP_EL1).
+#define GUEST_EXCEPTION_STACK 0x400
+
+// States of a guest.
+#define GUEST_READY   0 // Runnable.
+#define GUEST_EXITED  1 // Returned from its entry point.
+#define GUEST_FAULTED 2 // Took an unexpected exception (result is ESR_EL1).
+
+// Description of a guest, given (in EL1 memory) to HVC_GUEST_ADD. The first
+// fields are set by the host, and the others are maintained by EL2 (they are
+// updated each time the guest is switched out).
+typedef struct {
+  u64 entry;              // Entry point (called with arg in x0).
+  u64 arg;                // Argument.
+  u64 stack_top;          // Top of the stack (16-byte aligned).
+  volatile u64 state;     // One of the GUEST_* states.
+  volatile u64 result;    // Returned value (or ESR_EL1 if faulted).
+  volatile u64 cpu_ticks; // Time spent running (in counter ticks).
+  volatile u64 nb_slices; // Number of times the guest was switched in.
+  volatile u64 nb_virqs;  // Number of acknowledged virtual interrupts.
+} guest_info;
+
+// Exception vector and exit path of the guests (see "guest.S", run at EL1).
+extern char guest_vector[];
+extern char guest_exit[];
+
+// Statistics of world switches (for the calling core).
+typedef struct {
+  u64 nb_switches;   // Guest-to-guest switches on timer interrupts.
+  u64 latency_ticks; // Total time from the timer deadline to the next guest.
+  u64 max_latency;   // Maximum of the above.
+  u64 nb_preempted;  // Returns to the host due to a host interrupt.
+} guest_switch_stats;
+
+// Create a guest described by g (with an initial state), and return its index,
+// or a negative error. The hypercall checks that g is in the RAM of EL1.
+i64 guest_create(guest_info *g);
+
+// Remove all the guests of the calling core. Returns false if they are running.
+bool guest_reset();
+
+// Handle the hypercalls that switch worlds (HVC_GUEST_RUN and HVC_GUEST_EXIT),
+// which replace the contents of frame f. Returns false for other hypercalls.
+bool guest_hvc(hvc_frame *f);
+
+// Acknowledge the virtual interrupt of the running guest.
+i64 guest_ack();
+
+// Handle an IRQ taken to EL2 from a guest (called from "boot.S").
+void guest_irq(hvc_frame *f);
+
+void guest_get_switch_stats(guest_switch_stats *s);
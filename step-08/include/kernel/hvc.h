@@ -0,0 +1,154 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+
+// Hypercalls: services provided at EL2 to the kernel running at EL1.
+//
+// A hypercall is issued with "hvc #0", with the function ID in x0, and up to
+// seven arguments in x1 to x7. On return, x0 holds the result (negative values
+// are errors, see the HVC_ERR_* constants), x1 to x3 may hold additional
+// results (depending on the function), and all other registers are preserved.
+//
+// At EL2, all registers are saved on the stack of the core (SP_EL2, separate
+// from the stacks used at EL1), and the handler of the function is found in a
+// jump table indexed by function ID (see "hvc.c"). Adding a hypercall only
+// requires a new ID below, and a C handler in the table. Hypercalls can be
+// issued concurrently by all cores: the state of the hypervisor is either per
+// core (e.g., rings), or sharded per core and merged on read (the counter).
+//
+// Buffers given by EL1 (to be written by EL2) must be in the RAM of EL1, and
+// outside of the memory private to EL2 (see "kernel/stage2.h"): others are
+// rejected with HVC_ERR_INVALID.
+//
+// Operations can also be batched through a ring shared by EL1 and EL2 (see
+// "hvc_ring" below): EL1 writes operation descriptors into the ring, and then
+// issues a single hypercall to have all of them processed.
+
+// Size of the EL2 stack of each core (in bytes).
+#define HVC_STACK_SIZE 0x2000
+
+// Function IDs.
+#define HVC_NULL        0 // Do nothing (returns 0).
+#define HVC_COUNTER_INC 1 // Increment the (EL2) counter.
+#define HVC_COUNTER_GET 2 // Get the value of the counter.
+#define HVC_RING_SETUP  3 // Use the ring at address x1 for the calling core.
+#define HVC_RING_SUBMIT 4 // Process the ring of the calling core.
+#define HVC_S2_STATS    5 // Stage-2 fault counters (see "kernel/stage2.h").
+#define HVC_S2_LAST     6 // IPA of the last stage-2 fault of the calling core.
+#define HVC_VUART_STATS 7 // Virtual UART counters (see "kernel/vuart.h").
+#define HVC_VUART_CTL   8 // Virtual UART operation x1 (VUART_ON, ...).
+#define HVC_GUEST_ADD    9 // Create a guest (see "kernel/guest.h").
+#define HVC_GUEST_RUN   10 // Run the guests of the core (x1 us slices).
+#define HVC_GUEST_EXIT  11 // Exit the calling guest (with result x1).
+#define HVC_GUEST_ACK   12 // Acknowledge a virtual IRQ (from a guest).
+#define HVC_GUEST_STATS 13 // World switch counters of the calling core.
+#define HVC_GUEST_RESET 14 // Remove all the guests of the calling core.
+#define HVC_PROF_START  15 // Sample EL1 every x1 cycles (see "kernel/prof.h").
+#define HVC_PROF_STOP   16 // Stop sampling on the calling core.
+#define HVC_PROF_READ   17 // Copy the histogram of core x1 to x2 (x3 entries).
+#define HVC_MMIO_CTL    18 // MMIO tracing op. x1 (see "kernel/mmiotrace.h").
+#define HVC_MMIO_SITES  19 // Copy the sites of core x1 to x2 (x3 entries).
+#define HVC_MMIO_LOG    20 // Copy the log of core x1 to x2 (x3 entries).
+#define NB_HVC          21
+
+// Errors.
+#define HVC_ERR_UNKNOWN (-1) // Unknown function ID.
+#define HVC_ERR_INVALID (-2) // Invalid argument.
+
+// Registers saved on hypercall entry at EL2 (see "boot.S").
+typedef struct {
+  u64 x[31]; // Registers x0 to x30.
+  u64 elr;   // Return address (ELR_EL2).
+  u64 spsr;  // Saved process state (SPSR_EL2).
+  u64 pad;   // Padding (frames are 16-byte aligned).
+} hvc_frame;
+
+// Type of hypercall handlers (run at EL2, with interrupts masked). The function
+// ID is in x[0], arguments are in x[1] to x[7] (only x[1] to x[3] for batched
+// operations), the returned value is put in x0, and handlers can write
+// additional results to x[1] to x[3].
+typedef i64 (*hvc_fn)(u64 *x);
+
+// Number of operations in a ring.
+#define HVC_RING_SIZE 512
+
+// An operation descriptor (one cache line): the function ID and arguments, and
+// the result (written on completion, with the additional results in x[1] to
+// x[3]).
+typedef struct {
+  u64 x[4];
+  i64 result;
+  u64 pad[3];
+} hvc_op;
+
+// Ring of operations of a core. EL1 writes descriptors at index tail, and EL2
+// processes (and completes) them from index head to tail on HVC_RING_SUBMIT.
+// Indices are free-running counters, reduced modulo the size of the ring. The
+// descriptor of index i is valid until index i + HVC_RING_SIZE is pushed.
+// Rings cannot contain HVC_RING_SETUP and HVC_RING_SUBMIT operations.
+typedef struct {
+  volatile u64 head;
+  volatile u64 tail;
+  hvc_op ops[HVC_RING_SIZE] __attribute__((aligned(64)));
+} hvc_ring;
+
+// Issue the hypercall with the given ID and arguments, and return x0.
+static inline i64 hvc_call(u64 id, u64 a1, u64 a2, u64 a3){
+  register u64 x0 asm("x0") = id;
+  register u64 x1 asm("x1") = a1;
+  register u64 x2 asm("x2") = a2;
+  register u64 x3 asm("x3") = a3;
+  asm volatile("hvc #0"
+               : "+r" (x0), "+r" (x1), "+r" (x2), "+r" (x3)
+               :
+               : "memory");
+  return (i64) x0;
+}
+
+// Issue the hypercall with the given ID and arguments, return x0, and write
+// the additional results (x1 to x3) to res.
+static inline i64 hvc_call_res(u64 id, u64 a1, u64 a2, u64 a3, u64 res[3]){
+  register u64 x0 asm("x0") = id;
+  register u64 x1 asm("x1") = a1;
+  register u64 x2 asm("x2") = a2;
+  register u64 x3 asm("x3") = a3;
+  asm volatile("hvc #0"
+               : "+r" (x0), "+r" (x1), "+r" (x2), "+r" (x3)
+               :
+               : "memory");
+  res[0] = x1;
+  res[1] = x2;
+  res[2] = x3;
+  return (i64) x0;
+}
+
+// Initialise the ring r, and have EL2 use it for the calling core.
+static inline bool hvc_ring_setup(hvc_ring *r){
+  r->head = 0;
+  r->tail = 0;
+  return hvc_call(HVC_RING_SETUP, (u64) r, 0, 0) == 0;
+}
+
+// Push an operation into the ring r (which must have been set up on the calling
+// core), and return its descriptor. The ring must not be full.
+static inline hvc_op *hvc_ring_push(hvc_ring *r, u64 id, u64 a1, u64 a2,
+                                    u64 a3){
+  hvc_op *op = &(r->ops[r->tail % HVC_RING_SIZE]);
+  op->x[0] = id;
+  op->x[1] = a1;
+  op->x[2] = a2;
+  op->x[3] = a3;
+  r->tail++;
+  return op;
+}
+
+// Number of operations that can be pushed into the ring r.
+static inline u64 hvc_ring_space(hvc_ring *r){
+  return HVC_RING_SIZE - (r->tail - r->head);
+}
+
+// Have EL2 process all the pending operations of the ring of the calling core.
+// Returns the number of processed operations (or a negative error).
+static inline i64 hvc_ring_submit(void){
+  return hvc_call(HVC_RING_SUBMIT, 0, 0, 0);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/smp.h>
+
+// Inter-processor interrupts (IPIs), using the mailboxes of the ARM local
+// peripherals (see "bcm2837/local.h").
+//
+// Mailbox 0 of each core is reserved for cross-core function calls: the
+// sender writes its own core bit to the mailbox of the target, which raises
+// an IRQ on the target. Each (target, sender) pair has its own call slot, so
+// the cores do not need any lock to communicate.
+//
+// Note: called functions run in the IRQ handler of the target core, so they
+// must be short, and must not block. The target must have IRQs enabled for
+// the call to complete (secondary cores always do when idle, and the main
+// core does once "sched_start" has been called).
+
+// Mailbox used for IPIs.
+#define IPI_MAILBOX 0
+
+// Enable the IPI interrupt on the calling core (and register its handler).
+void ipi_init_core();
+
+// Run fn(arg) on the given core, and wait for it to complete. When the given
+// core is the caller, fn(arg) is simply run directly (with IRQs masked). This
+// returns false if the core is offline, or if the caller has IRQs masked while
+// another thread of its core is setting up a call to the same target. Two
+// cores must not call each other with IRQs masked (they would deadlock).
+bool smp_call_function(u64 core, smp_fn fn, void *arg);
+
+// Same as "smp_call_function", but without waiting for fn(arg) to complete
+// (arg must remain valid until it has, see "smp_call_wait").
+bool smp_call_function_async(u64 core, smp_fn fn, void *arg);
+
+// Wait until the calls made from the calling core to the given core are done.
+void smp_call_wait(u64 core);
+
+// Number of IPIs received by the given core.
+u64 ipi_nb_received(u64 core);
+
+// Operations for "smp_shootdown".
+#define SHOOTDOWN_TLB_ALL  0 // Invalidate all the EL1 TLB entries.
+#define SHOOTDOWN_TLB_VA   1 // Invalidate the EL1 TLB entries of a range.
+#define SHOOTDOWN_DCACHE   2 // Clean and invalidate a data cache range.
+#define SHOOTDOWN_ICACHE   3 // Invalidate the instruction cache.
+
+// Maximum number of operations in a shootdown batch.
+#define SHOOTDOWN_MAX_OPS 16
+
+// A batch of TLB / cache maintenance operations.
+typedef struct {
+  u64 nb_ops;
+  struct {
+    u64 op;   // One of the SHOOTDOWN_* constants.
+    u64 addr; // Start of the range (for SHOOTDOWN_TLB_VA and SHOOTDOWN_DCACHE).
+    u64 size; // Size of the range (in bytes).
+  } ops[SHOOTDOWN_MAX_OPS];
+} shootdown_batch;
+
+// Initialise an empty batch.
+void shootdown_init(shootdown_batch *b);
+
+// Add an operation to a batch. Returns false if the batch is full.
+bool shootdown_add(shootdown_batch *b, u64 op, u64 addr, u64 size);
+
+// Perform all the operations of the batch on each of the cores of the mask
+// (bit i for core i), including the caller if its bit is set. A single IPI is
+// sent to each core, and all cores work in parallel. This returns when every
+// core is done, and returns the mask of the cores that did the operations.
+u64 smp_shootdown(u64 core_mask, shootdown_batch *b);
@@ -0,0 +1,113 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+
+// Registers saved on exception entry at EL1 (see "vectors.S").
+typedef struct {
+  u64 x[31]; // Registers x0 to x30.
+  u64 elr;   // Return address (ELR_EL1).
+  u64 spsr;  // Saved process state (SPSR_EL1).
+  u64 pad;   // Padding (frames are 16-byte aligned).
+} exception_frame;
+
+// IRQ numbers, for the two levels of interrupt controllers: first the sources
+// of the ARM local interrupt controller (see "bcm2837/local.h"), then the GPU
+// and ARM-specific IRQs of the BCM2835 interrupt controller (which are signaled
+// as local source "GPU", see "bcm2837/armctrl.h").
+#define IRQ_LOCAL(n) (n)        // Local source n (from 0 to 11).
+#define IRQ_GPU(n)   (16 + (n)) // GPU IRQ n (from 0 to 63).
+#define IRQ_ARM(n)   (80 + (n)) // ARM-specific (basic) IRQ n (from 0 to 7).
+#define NB_IRQS      88
+
+// Local sources used by the kernel.
+#define IRQ_CNTPNS      IRQ_LOCAL(1)        // Generic timer (EL1 physical).
+#define IRQ_CNTV        IRQ_LOCAL(3)        // Generic timer (virtual).
+#define IRQ_MAILBOX(mb) IRQ_LOCAL(4 + (mb)) // Mailbox mb of the core.
+#define IRQ_GPU_SOURCE  IRQ_LOCAL(8)        // Any GPU / ARM-specific IRQ.
+
+// Type of IRQ handlers (called with IRQs masked).
+typedef void (*irq_handler)(void *arg);
+
+// Statistics for an IRQ on a given core. Times are in generic timer ticks. The
+// latency (time between the event and the start of the handler) is only known
+// for IRQs whose handler reports it (see "irq_record_latency").
+typedef struct {
+  u64 count;      // Number of times the handler was run.
+  u64 time_total; // Total time spent in the handler.
+  u64 time_max;   // Maximum time spent in the handler.
+  u64 lat_count;  // Number of latency measurements.
+  u64 lat_total;  // Sum of the latencies.
+  u64 lat_max;    // Maximum latency.
+} irq_stats;
+
+// Install the EL1 exception vector on the calling core.
+void irq_init();
+
+// Register the handler for the given IRQ (shared by all cores). This fails if
+// the IRQ is invalid, or already has a handler (unless it is the same). This
+// does not enable the IRQ source: local sources are enabled on each core by
+// their driver, and GPU / ARM-specific ones with "irq_unmask_source".
+bool irq_register(u64 irq, const char *name, irq_handler fn, void *arg);
+
+// Remove the handler of the given IRQ (masking it first if possible).
+void irq_unregister(u64 irq);
+
+// Enable (or disable) a GPU or ARM-specific IRQ in the BCM2835 interrupt
+// controller. These IRQs are routed to core 0.
+void irq_unmask_source(u64 irq);
+void irq_mask_source(u64 irq);
+
+// Name of the handler of the given IRQ (or NULL if there is none).
+const char *irq_name(u64 irq);
+
+// Indicates whether the calling core is running an IRQ handler.
+bool irq_in_handler();
+
+// Time (generic timer ticks) at which the current IRQ was taken on the calling
+// core (only meaningful in IRQ handlers).
+u64 irq_entry_ticks();
+
+// Registers of the code interrupted by the current IRQ on the calling core
+// (only meaningful in IRQ handlers), e.g., its PC in field elr.
+const exception_frame *irq_frame();
+
+// Record a latency measurement for the given IRQ on the calling core.
+void irq_record_latency(u64 irq, u64 ticks);
+
+// Get the statistics for the given IRQ and core, and reset all statistics.
+void irq_get_stats(u64 irq, u64 core, irq_stats *s);
+void irq_reset_stats();
+
+// Number of IRQs without a handler taken by the given core.
+u64 irq_nb_spurious(u64 core);
+
+// Unmask IRQs on the calling core.
+static inline void irq_enable(void){
+  asm volatile("msr daifclr, #2" : : : "memory");
+}
+
+// Mask IRQs on the calling core.
+static inline void irq_disable(void){
+  asm volatile("msr daifset, #2" : : : "memory");
+}
+
+// Mask IRQs on the calling core, and return the previous interrupt state (to
+// be given to "irq_restore").
+static inline u64 irq_save(void){
+  u64 flags;
+  asm volatile("mrs %0, daif; msr daifset, #2" : "=r" (flags) : : "memory");
+  return flags;
+}
+
+// Restore the interrupt state returned by "irq_save".
+static inline void irq_restore(u64 flags){
+  asm volatile("msr daif, %0" : : "r" (flags) : "memory");
+}
+
+// Indicates whether IRQs are masked on the calling core (which is always the
+// case in interrupt handlers).
+static inline bool irq_masked(void){
+  u64 flags;
+  asm volatile("mrs %0, daif" : "=r" (flags));
+  return (flags >> 7) & 1;
+}
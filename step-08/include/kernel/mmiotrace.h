@@ -0,0 +1,77 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/hvc.h>
+
+// Tracing of the MMIO accesses of EL1 to the BCM2837 peripherals, at EL2.
+//
+// While tracing, the peripherals (physical addresses 0x3f000000 to 0x3fffffff)
+// are unmapped at stage 2, so that each access of EL1 traps to EL2, where it is
+// performed on the device (with the same width and value), and recorded:
+// - in a log of the last accesses of the core (address, width, value, PC),
+// - in a table of the core counting the reads and writes of each register for
+//   each calling site (PC).
+// Per-register counts are obtained by adding up the counts of all the sites.
+//
+// Only accesses with a valid syndrome (single loads and stores without write
+// back) can be emulated: the first other access stops tracing (it is then
+// re-executed natively). Accesses to the UART emulated by the virtual UART (see
+// "kernel/vuart.h") are not traced.
+//
+// Tracing is controlled with the HVC_MMIO_* hypercalls.
+//
+// Note: the functions of this module run at EL2.
+
+// Number of (register, site) pairs recorded by each core.
+#define MMIOTRACE_SITES 1024
+
+// Number of accesses in the log of each core.
+#define MMIOTRACE_LOG 256
+
+// Operations of the HVC_MMIO_CTL hypercall (given in x1).
+#define MMIOTRACE_STOP  0 // Stop tracing (tables and logs are kept).
+#define MMIOTRACE_START 1 // Reset the tables and logs, and start tracing.
+
+// Counts of the accesses to a register from a site.
+typedef struct {
+  u64 addr;   // Address of the register.
+  u64 pc;     // Address of the accessing instruction.
+  u64 reads;
+  u64 writes;
+} mmiotrace_site;
+
+// An access, as recorded in the logs.
+#define MMIOTRACE_WRITE (1ULL << 63) // Flag of writes (in field size).
+typedef struct {
+  u64 addr;  // Address of the register.
+  u64 pc;    // Address of the accessing instruction.
+  u64 value; // Value written, or read.
+  u64 size;  // Width (in bytes), with the MMIOTRACE_WRITE flag for writes.
+} mmiotrace_access;
+
+// Statistics of a core.
+typedef struct {
+  u64 nb_traps;   // Traced accesses.
+  u64 nb_dropped; // Accesses whose (register, site) pair did not fit a table.
+  u64 stopped_pc; // PC of the access that stopped tracing (0 if none).
+} mmiotrace_stats;
+
+// Perform the given operation (one of the MMIOTRACE_* constants). Returns false
+// for invalid operations.
+bool mmiotrace_ctl(u64 op);
+
+// Unmap the peripherals again if they are traced (after their mappings were
+// changed by another module, see "kernel/vuart.h").
+void mmiotrace_remap();
+
+// Handle a data abort taken to EL2 from EL1, with the given syndrome (ESR_EL2).
+// Returns false if the abort is not an access to the traced peripherals.
+bool mmiotrace_data_abort(hvc_frame *f, u64 esr);
+
+// Copy at most max entries of the table of sites (or of the log, oldest first)
+// of the given core to buf (in EL1 memory), and return their number.
+u64 mmiotrace_read_sites(u64 core, mmiotrace_site *buf, u64 max);
+u64 mmiotrace_read_log(u64 core, mmiotrace_access *buf, u64 max);
+
+// Get the statistics of the given core.
+void mmiotrace_get_stats(u64 core, mmiotrace_stats *s);
@@ -0,0 +1,21 @@
+#pragma once
+
+// Memory attribute indices (into the MAIR_ELx registers) used in our tables.
+#define MT_DEVICE    0 // Device-nGnRnE memory (peripherals).
+#define MT_NORMAL    1 // Normal memory, write-back cacheable.
+#define MT_NORMAL_NC 2 // Normal memory, non-cacheable.
+
+// Both EL2 and EL1 use an identity mapping of the first 2GB of the physical
+// address space (RAM, BCM2837 peripherals and ARM local peripherals).
+//
+// Important: the MMU (and caches) of both EL2 and EL1 are enabled from EL2,
+// before we first move to EL1. This way, EL1 never runs with caches disabled,
+// and never sees stale cache lines allocated at EL2 (e.g., for the stack).
+
+// Build the translation tables, and enable the MMU and caches for both EL2 and
+// EL1. Must be called at EL2 by the main core, before waking up other cores.
+void mmu_init();
+
+// Enable the MMU and caches for both EL2 and EL1 (at EL2) using the tables that
+// were built by "mmu_init". Used by the secondary cores.
+void mmu_enable();
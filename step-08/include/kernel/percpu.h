@@ -0,0 +1,50 @@
+#pragma once
+#include <types.h>
+
+// Per-core variables.
+//
+// Variables declared with DEFINE_PER_CPU are placed in the ".percpu" section,
+// which is only a template: "percpu_init_core" gives each core its own copy of
+// the section (see "kernel8.ld"). Copies are cache-line aligned, and a whole
+// number of cache lines long, so that cores never share a cache line when they
+// access their own variables.
+//
+// Register TPIDR_EL1 holds the offset from the template to the copy of the
+// core, so that accessing a per-core variable only takes an "mrs", and a load
+// (or store) with a register offset.
+//
+// Note: threads never migrate between cores, so the accessors can be used in
+// threads as long as read-modify-write sequences are not also performed by the
+// IRQ handlers of the same core.
+
+// Define a per-core variable of the given type and name (may be "static").
+#define DEFINE_PER_CPU(type, name) \
+  __attribute__((section(".percpu"))) type name
+
+// Offset from the template to the copy of the calling core (constant once the
+// copy has been initialised, hence no "volatile").
+static inline u64 percpu_offset(void){
+  u64 v;
+  asm("mrs %0, tpidr_el1" : "=r" (v));
+  return v;
+}
+
+// Offset from the template to the copy of the given core.
+u64 percpu_offset_of(u64 core);
+
+// Pointer to the copy of per-core variable var for the calling core.
+#define this_cpu_ptr(var) \
+  ((__typeof__(&(var))) ((u64) &(var) + percpu_offset()))
+
+// Read and write the copy of per-core variable var for the calling core.
+#define this_cpu_read(var)     (*this_cpu_ptr(var))
+#define this_cpu_write(var, v) (*this_cpu_ptr(var) = (v))
+
+// Pointer to the copy of per-core variable var for the given core.
+#define per_cpu_ptr(var, core) \
+  ((__typeof__(&(var))) ((u64) &(var) + percpu_offset_of(core)))
+
+// Create the copy of the per-core data of the calling core, and install it.
+// This must be called before any use of per-core variables on the core. Until
+// then, the copy of the core is zeroed (which is visible via "per_cpu_ptr").
+void percpu_init_core();
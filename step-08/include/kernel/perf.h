@@ -0,0 +1,60 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/twheel.h>
+
+// Counting of PMU events on the calling core (see "aarch64/pmu.h").
+//
+// A session counts CPU cycles (with the cycle counter), and any number of
+// events. When there are more events than event counters, they are split into
+// groups that take turns on the counters (multiplexing): the group is changed
+// every PERF_ROTATE_US microseconds (with a timer of the wheel, see
+// "kernel/twheel.h"), and the count of each event is scaled by the ratio of the
+// session time to the time it was counted. Counters are also read and reset on
+// each turn with a single group, so that they cannot overflow (32 bits).
+//
+// Counting is per core: all the code running on the core during the session is
+// counted (including interrupt handlers, hypercalls, and other threads if the
+// thread that started the session blocks). There is at most one session per
+// core.
+
+// Maximum number of events of a session.
+#define PERF_MAX_EVENTS 16
+
+// Time between two changes of group (in microseconds).
+#define PERF_ROTATE_US 1000
+
+typedef struct {
+  // Configuration (set by "perf_start").
+  u64 nb_events;
+  u64 events[PERF_MAX_EVENTS];  // Event numbers (PMU_EVENT_*).
+
+  // Results (valid after "perf_stop").
+  u64 counts[PERF_MAX_EVENTS];  // Counted events (not scaled).
+  u64 ticks[PERF_MAX_EVENTS];   // Time each event was counted (timer ticks).
+  u64 cycles;                   // CPU cycles.
+  u64 total_ticks;              // Duration of the session (timer ticks).
+  u64 nb_rotations;             // Number of changes of group.
+
+  // Internal state.
+  u64 nb_counters;              // Number of counters (size of the groups).
+  u64 group;                    // Index of the counting group.
+  u64 group_start;              // Time when the group started counting.
+  u64 start_ticks;
+  u64 start_cycles;
+  wtimer timer;
+} perf_session;
+
+// Start counting the n given events on the calling core. Returns false if n is
+// 0 or above PERF_MAX_EVENTS, if a session is running on the core, or if no
+// event counter is available.
+bool perf_start(perf_session *s, const u64 *events, u64 n);
+
+// Stop counting (on the core that started the session).
+void perf_stop(perf_session *s);
+
+// Number of groups of the session.
+u64 perf_nb_groups(const perf_session *s);
+
+// Estimated count of event i of the session, scaled for multiplexing.
+u64 perf_scaled(const perf_session *s, u64 i);
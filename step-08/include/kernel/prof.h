@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/hvc.h>
+
+// Statistical profiling of EL1 from EL2, without instrumenting the kernel.
+//
+// While profiling, the last event counter of the PMU is reserved for EL2 (with
+// field HPMN of MDCR_EL2, so that EL1 sees one counter less), and counts the
+// CPU cycles spent at EL0 and EL1 only. It overflows every given number of
+// cycles, and its interrupt is routed to the core as a FIQ, which is taken to
+// EL2 (HCR_EL2.FMO) even when EL1 masks interrupts. The handler records the
+// interrupted PC (ELR_EL2) in a histogram of the core (in the memory private
+// to EL2).
+//
+// Profiling is controlled per core with the HVC_PROF_* hypercalls, and the
+// histograms can be symbolised against "kernel8.elf" on the host (see target
+// "symbolize" of the Makefile).
+//
+// Note: the functions of this module run at EL2.
+
+// Number of distinct PCs recorded by each core (further ones are dropped).
+#define PROF_SLOTS 4096
+
+// Bounds on the sampling period (in CPU cycles), the counter being 32-bit.
+#define PROF_MIN_PERIOD 1000
+#define PROF_MAX_PERIOD 0xffffffffULL
+
+// An entry of a histogram.
+typedef struct {
+  u64 pc;    // Address of the sampled instruction.
+  u64 count; // Number of samples.
+} prof_sample;
+
+// Reset the histogram of the calling core, and sample every period cycles.
+// Returns false if the period is invalid, or if the PMU has no event counters.
+bool prof_start(u64 period);
+
+// Stop sampling on the calling core (the histogram is kept).
+void prof_stop();
+
+// Copy at most max entries of the histogram of the given core to buf (in EL1
+// memory), and return their number. The total number of samples, and of those
+// dropped due to a full histogram, are written to nb_samples and nb_dropped.
+u64 prof_read(u64 core, prof_sample *buf, u64 max, u64 *nb_samples,
+              u64 *nb_dropped);
+
+// Handle a FIQ taken to EL2 from EL1 (called from "boot.S").
+void prof_fiq(hvc_frame *f);
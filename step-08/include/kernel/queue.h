@@ -0,0 +1,183 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <aarch64/cache.h>
+
+// Lock-free bounded queues for message passing between cores.
+//
+// The queues are generated for a given element type and capacity (a power of
+// two) by the macros below, which define a type "name" and static functions
+// prefixed by "name_". For instance, using:
+//
+//   SPSC_QUEUE_DEFINE(u64_queue, u64, 1024)
+//
+// at file scope gives type "u64_queue", and functions "u64_queue_init",
+// "u64_queue_push", "u64_queue_pop", "u64_queue_push_bulk" and
+// "u64_queue_pop_bulk" (and "u64_queue_peek" for SPSC queues).
+//
+// The indices written by the producer(s) and by the consumer live on separate
+// cache lines, so that the two sides only share cache lines when they really
+// exchange data. Indices are free-running counters (they never wrap around in
+// practice), and are reduced modulo the capacity to find the slots.
+
+// Single-producer, single-consumer queue. Publication relies on acquire/release
+// accesses to the indices. Each side also keeps a private copy of the index of
+// the other side, which is only refreshed when the queue looks full (producer)
+// or empty (consumer): in steady state, the indices do not bounce between the
+// caches of the two cores.
+#define SPSC_QUEUE_DEFINE(name, type, capacity)                               \
+  _Static_assert(((capacity) & ((capacity) - 1)) == 0,                        \
+                 "capacity must be a power of two");                          \
+                                                                              \
+  typedef struct {                                                            \
+    /* Producer side. */                                                      \
+    volatile u64 tail __attribute__((aligned(CACHE_LINE_SIZE)));              \
+    u64 head_cache;                                                           \
+    /* Consumer side. */                                                      \
+    volatile u64 head __attribute__((aligned(CACHE_LINE_SIZE)));              \
+    u64 tail_cache;                                                           \
+    /* Elements. */                                                           \
+    type slots[capacity] __attribute__((aligned(CACHE_LINE_SIZE)));           \
+  } name;                                                                     \
+                                                                              \
+  static inline void name##_init(name *q){                                    \
+    q->tail = 0;                                                              \
+    q->head_cache = 0;                                                        \
+    q->head = 0;                                                              \
+    q->tail_cache = 0;                                                        \
+  }                                                                           \
+                                                                              \
+  /* Push up to n elements, and return the number of pushed elements. */     \
+  static inline u64 name##_push_bulk(name *q, const type *elts, u64 n){       \
+    u64 tail = q->tail;                                                       \
+    if(tail + n - q->head_cache > (capacity)){                                \
+      q->head_cache = atomic_load_acquire(&q->head);                          \
+      u64 space = (capacity) - (tail - q->head_cache);                        \
+      if(n > space) n = space;                                                \
+    }                                                                         \
+    for(u64 i = 0; i < n; i++){                                               \
+      q->slots[(tail + i) & ((capacity) - 1)] = elts[i];                      \
+    }                                                                         \
+    if(n) atomic_store_release(&q->tail, tail + n);                           \
+    return n;                                                                 \
+  }                                                                           \
+                                                                              \
+  /* Pop up to n elements, and return the number of popped elements. */       \
+  static inline u64 name##_pop_bulk(name *q, type *elts, u64 n){              \
+    u64 head = q->head;                                                       \
+    if(q->tail_cache - head < n){                                             \
+      q->tail_cache = atomic_load_acquire(&q->tail);                          \
+      u64 avail = q->tail_cache - head;                                       \
+      if(n > avail) n = avail;                                                \
+    }                                                                         \
+    for(u64 i = 0; i < n; i++){                                               \
+      elts[i] = q->slots[(head + i) & ((capacity) - 1)];                      \
+    }                                                                         \
+    if(n) atomic_store_release(&q->head, head + n);                           \
+    return n;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline bool name##_push(name *q, const type *elt){                   \
+    return name##_push_bulk(q, elt, 1) == 1;                                  \
+  }                                                                           \
+                                                                              \
+  static inline bool name##_pop(name *q, type *elt){                          \
+    return name##_pop_bulk(q, elt, 1) == 1;                                   \
+  }                                                                           \
+                                                                              \
+  /* Pointer to the next element to pop (or NULL if the queue is empty). */   \
+  /* The element remains valid until it is popped (by the consumer). */       \
+  static inline type *name##_peek(name *q){                                   \
+    u64 head = q->head;                                                       \
+    if(q->tail_cache == head){                                                \
+      q->tail_cache = atomic_load_acquire(&q->tail);                          \
+      if(q->tail_cache == head) return NULL;                                  \
+    }                                                                         \
+    return &q->slots[head & ((capacity) - 1)];                                \
+  }
+
+// Multiple-producer, single-consumer queue. Each slot carries a sequence
+// number: slot i is free for the producer claiming index p (with p modulo the
+// capacity equal to i) when its sequence number is p, and holds the element of
+// index p when its sequence number is p + 1. Producers claim indices with a
+// compare-and-swap on the tail, write their elements, and then publish each of
+// them with a release store of its sequence number. Since the consumer frees
+// slots in order, a producer can claim several indices at once by checking the
+// last slot only.
+#define MPSC_QUEUE_DEFINE(name, type, capacity)                               \
+  _Static_assert(((capacity) & ((capacity) - 1)) == 0,                        \
+                 "capacity must be a power of two");                          \
+                                                                              \
+  typedef struct {                                                            \
+    volatile u64 seq;                                                         \
+    type elt;                                                                 \
+  } name##_slot;                                                              \
+                                                                              \
+  typedef struct {                                                            \
+    /* Producers side. */                                                     \
+    volatile u64 tail __attribute__((aligned(CACHE_LINE_SIZE)));              \
+    /* Consumer side. */                                                      \
+    u64 head __attribute__((aligned(CACHE_LINE_SIZE)));                       \
+    /* Elements. */                                                           \
+    name##_slot slots[capacity] __attribute__((aligned(CACHE_LINE_SIZE)));    \
+  } name;                                                                     \
+                                                                              \
+  static inline void name##_init(name *q){                                    \
+    q->tail = 0;                                                              \
+    q->head = 0;                                                              \
+    for(u64 i = 0; i < (capacity); i++){                                      \
+      q->slots[i].seq = i;                                                    \
+    }                                                                         \
+    dmb_ish();                                                                \
+  }                                                                           \
+                                                                              \
+  /* Push up to n elements, and return the number of pushed elements. */     \
+  static inline u64 name##_push_bulk(name *q, const type *elts, u64 n){       \
+    u64 tail;                                                                 \
+    while(1){                                                                 \
+      tail = atomic_load_acquire(&q->tail);                                   \
+      u64 seq = atomic_load_acquire(&q->slots[tail & ((capacity) - 1)].seq);  \
+      if(seq != tail){                                                        \
+        if((i64) (seq - tail) < 0) return 0; /* Full. */                      \
+        continue; /* Another producer claimed the index. */                   \
+      }                                                                       \
+      /* Find how many of the n next slots are free (at least, the first). */ \
+      while(n > 1){                                                           \
+        u64 last = tail + n - 1;                                              \
+        volatile u64 *seq = &q->slots[last & ((capacity) - 1)].seq;           \
+        if(atomic_load_acquire(seq) == last) break;                           \
+        n /= 2;                                                               \
+      }                                                                       \
+      if(atomic_cas(&q->tail, tail, tail + n)) break;                         \
+    }                                                                         \
+    for(u64 i = 0; i < n; i++){                                               \
+      name##_slot *slot = &q->slots[(tail + i) & ((capacity) - 1)];           \
+      slot->elt = elts[i];                                                    \
+      atomic_store_release(&slot->seq, tail + i + 1);                         \
+    }                                                                         \
+    return n;                                                                 \
+  }                                                                           \
+                                                                              \
+  /* Pop up to n elements, and return the number of popped elements. */       \
+  static inline u64 name##_pop_bulk(name *q, type *elts, u64 n){              \
+    u64 head = q->head;                                                       \
+    u64 i = 0;                                                                \
+    for(; i < n; i++){                                                        \
+      name##_slot *slot = &q->slots[(head + i) & ((capacity) - 1)];           \
+      if(atomic_load_acquire(&slot->seq) != head + i + 1) break;              \
+      elts[i] = slot->elt;                                                    \
+      atomic_store_release(&slot->seq, head + i + (capacity));                \
+    }                                                                         \
+    q->head = head + i;                                                       \
+    return i;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline bool name##_push(name *q, const type *elt){                   \
+    return name##_push_bulk(q, elt, 1) == 1;                                  \
+  }                                                                           \
+                                                                              \
+  static inline bool name##_pop(name *q, type *elt){                          \
+    return name##_pop_bulk(q, elt, 1) == 1;                                   \
+  }
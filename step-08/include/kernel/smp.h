@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+
+// Number of cores of the BCM2837 (a cluster of four Cortex-A53).
+#define NB_CORES 4
+
+// Index (from 0 to NB_CORES-1) of the core running the caller.
+static inline u64 smp_core_id(void){
+  return read_mpidr_el1() & 0xff;
+}
+
+// Type of the functions that can be run on a given core.
+typedef void (*smp_fn)(void *arg);
+
+// Wake up the secondary cores, and wait for them to come online. This must be
+// called by the main core, once.
+void smp_init();
+
+// Entry point (in C) of the secondary cores, called from "boot.S" at EL1.
+// This function never returns: the core waits for work given by "smp_run_on",
+// and serves IPIs (see "kernel/ipi.h").
+void smp_secondary_entry(u64 core);
+
+// Indicates whether the given core is online.
+bool smp_is_online(u64 core);
+
+// Number of online cores.
+u64 smp_nb_online();
+
+// Ask the given core to run fn(arg), without waiting for it to complete. This
+// fails (and returns false) if the given core is the caller, if it is offline,
+// or if it is already running a function.
+bool smp_run_on(u64 core, smp_fn fn, void *arg);
+
+// Wait until the given core has finished running the function it was given.
+void smp_wait(u64 core);
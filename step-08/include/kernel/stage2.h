@@ -0,0 +1,77 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/hvc.h>
+
+// Stage-2 translation (at EL2) of the addresses used by EL1.
+//
+// EL1 physical addresses (IPAs) are translated with an identity mapping of the
+// first 2GB, using 2MB blocks for RAM and BCM2837 peripherals, and a 1GB block
+// for the ARM local peripherals, so that walks are short and TLB entries cover
+// large ranges. The blocks containing pages that need specific permissions
+// (see "stage2_protect") are split into 4KB pages, and only these.
+//
+// The memory private to EL2 (EL2 stacks, stage-2 tables, and all the other
+// state of EL2, placed in the ".hyp" section by "kernel8.ld") is unmapped, so
+// that EL1 cannot access it. The code and read-only data of the kernel, which
+// include those of EL2 (e.g., the jump table of hypercalls), are read-only.
+//
+// Accesses of EL1 to unmapped (or protected) pages trap to EL2: loads return 0
+// and stores are ignored (when the faulting instruction can be emulated), and
+// faults are counted (see the HVC_STAGE2_STATS hypercall).
+//
+// Note: the functions of this module run at EL2.
+
+// Fields of the syndrome (ESR_EL2) of data aborts.
+#define ISS_ISV       (1ULL << 24)            // Syndrome valid (fields below).
+#define ISS_SAS(esr)  (((esr) >> 22) & 0x3)   // Access size (log2 of bytes).
+#define ISS_SSE       (1ULL << 21)            // Sign-extended load.
+#define ISS_SF        (1ULL << 15)            // 64-bit transfer register.
+#define ISS_SRT(esr)  (((esr) >> 16) & 0x1f)  // Transfer register.
+#define ISS_CM        (1ULL << 8)             // Cache maintenance instruction.
+#define ISS_WNR       (1ULL << 6)             // Write (rather than read).
+#define ISS_DFSC(esr) ((esr) & 0x3f)          // Fault status code.
+
+// Permissions for "stage2_protect".
+#define S2_NONE 0 // No access.
+#define S2_RO   1 // Read-only.
+#define S2_RW   3 // Read-write.
+
+// Build the stage-2 tables, and enable stage-2 translation on the calling core.
+// Must be called at EL2 by the main core, after "mmu_init".
+void stage2_init();
+
+// Enable stage-2 translation on the calling core (at EL2) using the tables that
+// were built by "stage2_init". Used by the secondary cores.
+void stage2_enable();
+
+// Set the permissions of the 4KB pages covering size bytes at IPA ipa,
+// splitting blocks as needed (2MB blocks covered by the range are not split).
+// Only the first 1GB (RAM and BCM2837 peripherals) can be protected. Returns
+// false if the range is not in the first 1GB, or if there are no more tables
+// to split blocks. Changes are serialised with a lock (they can be made by any
+// core).
+bool stage2_protect(u64 ipa, u64 size, u64 perm);
+
+// IPA of the access causing the stage-2 fault being handled.
+u64 stage2_fault_ipa();
+
+// Handle a data abort taken to EL2 from EL1, with the given syndrome (ESR_EL2),
+// that was not handled by an emulated device (see "kernel/vuart.h") or by MMIO
+// tracing (see "kernel/mmiotrace.h"). Accesses that the current mappings allow
+// (after a concurrent change) are performed again. Returns false if the abort
+// is not a stage-2 fault.
+bool stage2_data_abort(hvc_frame *f, u64 esr);
+
+// Statistics of stage-2 faults (for all cores), and of the tables.
+typedef struct {
+  u64 nb_translation; // Translation faults (unmapped pages).
+  u64 nb_permission;  // Permission faults (e.g., writes to read-only pages).
+  u64 nb_unemulated;  // Faulting instructions skipped without emulation.
+  u64 nb_split;       // Number of 2MB blocks split into 4KB pages.
+} stage2_stats;
+
+void stage2_get_stats(stage2_stats *s);
+
+// Address (IPA) of the last stage-2 fault of the calling core (0 if none).
+u64 stage2_last_fault();
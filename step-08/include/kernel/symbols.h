@@ -0,0 +1,22 @@
+#pragma once
+#include <types.h>
+
+// Table of the functions of the kernel, embedded in the image.
+//
+// The table is generated from the symbols of "kernel8.elf" by "symbols.awk",
+// when building the image (see the Makefile). It contains the local and global
+// code symbols (functions, and labels of the assembly files), by increasing
+// address. Names live in the read-only data of the image as well.
+
+typedef struct {
+  u64 addr;         // Start address.
+  const char *name;
+} symbol;
+
+// The table, and its number of entries.
+extern const symbol kernel_symbols[];
+extern const u64 kernel_nb_symbols;
+
+// Symbol containing the given address, i.e., the last one starting at or below
+// it, or NULL if the address is not in the code of the kernel.
+const symbol *symbol_lookup(u64 addr);
@@ -0,0 +1,151 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+
+// Kernel threads, with a preemptive priority scheduler.
+//
+// Each core has its own set of threads (a thread always runs on the core that
+// created it), and its own run queue (one FIFO queue per priority level). The
+// highest-priority ready thread runs, until it gives up the CPU (using, e.g.,
+// "thread_yield", "thread_sleep_us" or "event_wait"), or until it is preempted
+// by the generic timer interrupt. Threads with the same priority share the CPU
+// in a round-robin fashion, with time slices of configurable length. When no
+// thread is ready, the core runs its idle thread (the initial flow of control
+// of the core, which calls "sched_start").
+//
+// Note: threads and events are core-local: they must not be shared between
+// threads running on different cores.
+
+// Maximum number of threads (for all cores, idle threads excluded).
+#define MAX_THREADS 16
+
+// Size of the stack of a thread (in bytes).
+#define THREAD_STACK_SIZE 0x4000
+
+// Number of priority levels (higher values mean higher priorities).
+#define NB_PRIORITIES 8
+
+// Default priority of threads.
+#define PRIO_DEFAULT 3
+
+// States of a thread.
+#define THREAD_FREE     0 // Unused thread descriptor.
+#define THREAD_READY    1 // In the run queue of its core.
+#define THREAD_RUNNING  2 // Currently running on its core.
+#define THREAD_SLEEPING 3 // Waiting for a deadline (see "thread_sleep_us").
+#define THREAD_WAITING  4 // Waiting for an event (see "event_wait").
+#define THREAD_DEAD     5 // Terminated.
+
+// Scheduler timer modes.
+#define SCHED_PERIODIC 0 // The timer fires at the end of every time slice.
+#define SCHED_TICKLESS 1 // The timer is only programmed when needed: to end the
+                         // time slice if other threads of the same priority are
+                         // ready, or to wake up sleeping threads.
+
+// Context saved on a context switch (see "switch.S"): callee-saved registers
+// x19 to x28, frame pointer, link register and stack pointer.
+typedef struct {
+  u64 x19_x28[10];
+  u64 fp;
+  u64 lr;
+  u64 sp;
+} thread_context;
+
+// Type of the function run by a thread.
+typedef void (*thread_fn)(void *arg);
+
+// Descriptor of a thread.
+typedef struct thread {
+  thread_context ctx;  // Saved context (when not running).
+  u64 id;              // Unique identifier.
+  const char *name;    // Name (for display purposes).
+  u64 state;           // One of the THREAD_* constants.
+  u64 prio;            // Priority (from 0 to NB_PRIORITIES-1).
+  u64 core;            // Core on which the thread runs.
+  u64 wake_time;       // Deadline (in timer ticks) when sleeping.
+  struct thread *next; // Next thread in a queue (run queue, or wait queue).
+  thread_fn fn;        // Function run by the thread.
+  void *arg;           // Argument given to fn.
+  u64 nb_switches;     // Number of times the thread was switched to.
+  u64 nb_preempted;    // Number of times the thread was preempted.
+  u64 runtime;         // Time spent running (in timer ticks).
+} thread;
+
+// An event, on which threads can wait.
+typedef struct {
+  thread *waiters;  // Threads waiting for the event.
+  volatile u64 seq; // Number of times the event was signaled.
+} event;
+
+// Create a new thread running fn(arg) on the calling core, with the given
+// priority (clamped to the valid range). The thread becomes ready, and it runs
+// immediately if it has a higher priority than the caller. Returns NULL if no
+// thread descriptor is available.
+thread *thread_create(const char *name, u64 prio, thread_fn fn, void *arg);
+
+// Turn the caller into the idle thread of its core, enable IRQs, and start to
+// run other threads (never returns).
+void sched_start();
+
+// Set the timer mode (SCHED_PERIODIC or SCHED_TICKLESS), and the length of a
+// time slice (in microseconds), for all cores.
+void sched_configure(u64 mode, u64 slice_us);
+
+// Current timer mode, and length of a time slice (in microseconds).
+u64 sched_mode();
+u64 sched_slice_us();
+
+// Handle a timer interrupt on the calling core (called by the timer driver).
+void sched_timer_tick();
+
+// Perform the preemption requested by IRQ handlers (if any). This is called by
+// the IRQ dispatcher once the handlers are done, so that the interrupted thread
+// is switched out with its frame saved on its own stack.
+void sched_irq_exit();
+
+// Thread currently running on the calling core (NULL if "sched_start" has not
+// been called on this core).
+thread *thread_current();
+
+// Give up the CPU, letting other ready threads of higher or equal priority
+// run. The caller stays ready. Does nothing if "sched_start" has not been
+// called on the calling core, or if IRQs are masked (e.g., in handlers).
+void thread_yield();
+
+// Block the calling thread for (at least) the given number of microseconds.
+void thread_sleep_us(u64 us);
+
+// Terminate the calling thread (never returns).
+void thread_exit();
+
+// Initialise an event.
+void event_init(event *ev);
+
+// Block the calling thread until the event is signaled.
+void event_wait(event *ev);
+
+// Block the calling thread until the event is signaled, unless it has been
+// signaled since its "seq" field had value seq.
+void event_wait_seq(event *ev, u64 seq);
+
+// Wake up all the threads waiting for the event. This can be used in interrupt
+// handlers (of the core running the waiting threads).
+void event_signal(event *ev);
+
+// Block the calling thread until the condition cond holds, re-evaluating the
+// condition each time the event ev is signaled. Reading the sequence number of
+// the event before evaluating the condition ensures that a signal sent between
+// the evaluation and the call to "event_wait_seq" is not lost.
+#define wait_event(ev, cond) \
+  do { \
+    u64 wait_event_seq_ = (ev)->seq; \
+    while(!(cond)){ \
+      event_wait_seq((ev), wait_event_seq_); \
+      wait_event_seq_ = (ev)->seq; \
+    } \
+  } while(0)
+
+// Fill the array ts (of size max) with the threads of all cores, including
+// the idle threads of the cores that called "sched_start", and return their
+// number.
+u64 thread_list(thread **ts, u64 max);
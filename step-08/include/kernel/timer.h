@@ -0,0 +1,34 @@
+#pragma once
+#include <types.h>
+
+// Per-core timer interrupts, using the EL1 physical timer of the generic timer
+// (CNTP_*_EL0 registers), routed to the IRQ line of each core by the ARM local
+// interrupt controller.
+//
+// The timer of each core is shared by several clients, each with its own
+// one-shot deadline: the timer is programmed for the earliest one (or disabled
+// if there is none), and the handler of each client whose deadline has passed
+// is called on interrupt. Handlers typically program their next deadline.
+
+// Clients of the timer.
+#define TIMER_SCHED      0 // The scheduler (time slices, sleeping threads).
+#define TIMER_WHEEL      1 // The timer wheel (see "kernel/twheel.h").
+#define NB_TIMER_CLIENTS 2
+
+// Route the timer interrupt of the calling core to its IRQ line, and register
+// its handler (the timer is initially disabled). This must be called on each
+// core, before any other function of this module.
+void timer_init_core();
+
+// Set the deadline of the given client (on the calling core), to the given
+// number of timer ticks from now (at the frequency given by CNTFRQ_EL0), or to
+// the given absolute value of the counter (CNTPCT_EL0).
+void timer_set_oneshot(u64 client, u64 ticks);
+void timer_set_deadline(u64 client, u64 deadline);
+
+// Remove the deadline of the given client (on the calling core).
+void timer_disable(u64 client);
+
+// Convert microseconds into timer ticks (and back).
+u64 timer_us_to_ticks(u64 us);
+u64 timer_ticks_to_us(u64 ticks);
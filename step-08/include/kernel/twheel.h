@@ -0,0 +1,92 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+
+// Timer wheel, for (many) deferred callbacks and timeouts.
+//
+// Each core has its own hierarchical timer wheel, formed of TWHEEL_LEVELS
+// levels of TWHEEL_SLOTS slots: a slot of level 0 holds the timers expiring at
+// a given wheel tick (of TWHEEL_TICK_US microseconds), and a slot of level l
+// holds the timers expiring in a range of TWHEEL_SLOTS^l ticks, which are moved
+// to lower levels ("cascaded") when that range is reached. Slots are doubly
+// linked lists, so arming and cancelling a timer take constant time.
+//
+// The wheel is driven by the generic timer in one-shot mode: it is programmed
+// for the next tick at which a slot of level 0 expires or a slot needs to be
+// cascaded, so no interrupt happens for empty ticks. All the timers expiring
+// at the same tick are run in a single batch.
+//
+// Callbacks run in the timer interrupt handler of the core that armed the
+// timer (with IRQs masked): they must be short, and must not block. They may
+// re-arm their own timer.
+
+// Length of a wheel tick (in microseconds).
+#define TWHEEL_TICK_US 100
+
+// Geometry of the wheel (covering 64^5 ticks, i.e., about 30 hours).
+#define TWHEEL_SLOT_BITS 6
+#define TWHEEL_SLOTS     (1 << TWHEEL_SLOT_BITS)
+#define TWHEEL_LEVELS    5
+
+// Number of buckets of the (log2) lateness histograms.
+#define TWHEEL_HIST_SIZE 16
+
+// Type of timer callbacks.
+typedef void (*wtimer_fn)(void *arg);
+
+// A timer (allocated by its user, and initialised with "wtimer_init").
+typedef struct wtimer {
+  struct wtimer *next; // Next timer in the slot.
+  struct wtimer *prev; // Previous timer in the slot.
+  u64 expires;         // Expiry wheel tick.
+  u64 deadline;        // Requested deadline (generic timer ticks).
+  u64 level;           // Level of the slot holding the timer.
+  u64 slot;            // Index of the slot holding the timer.
+  u64 core;            // Core on which the timer was armed.
+  bool pending;        // Is the timer armed?
+  wtimer_fn fn;        // Callback.
+  void *arg;           // Argument given to fn.
+} wtimer;
+
+// Statistics of the wheel of a core.
+typedef struct {
+  u64 nb_pending;                 // Number of armed timers.
+  u64 nb_armed;                   // Number of calls to "wtimer_arm".
+  u64 nb_cancelled;               // Number of timers cancelled while armed.
+  u64 nb_expired;                 // Number of callbacks run.
+  u64 nb_batches;                 // Number of ticks with expired timers.
+  u64 max_batch;                  // Maximum number of timers in a batch.
+  u64 nb_cascaded;                // Number of timers moved between levels.
+  u64 hist[TWHEEL_HIST_SIZE];     // Lateness: bucket i counts lateness in
+                                  // [2^(i-1), 2^i) microseconds (0 for i = 0).
+} twheel_stats;
+
+// Initialise the timer wheel of the calling core (after "timer_init_core").
+void twheel_init_core();
+
+// Handler of the wheel's deadline (called by the timer driver).
+void twheel_expire();
+
+// Initialise a timer, with its callback.
+void wtimer_init(wtimer *t, wtimer_fn fn, void *arg);
+
+// Arm (or re-arm) the timer to expire after the given number of microseconds,
+// on the calling core. The callback is never run early, and is typically run
+// less than a wheel tick late.
+void wtimer_arm(wtimer *t, u64 us);
+
+// Cancel the timer (which must have been armed on the calling core). Returns
+// true if the timer was pending.
+bool wtimer_cancel(wtimer *t);
+
+// Indicates whether the timer is armed.
+bool wtimer_pending(wtimer *t);
+
+// Get the statistics of the wheel of the given core, or reset those of all the
+// cores.
+void twheel_get_stats(u64 core, twheel_stats *s);
+void twheel_reset_stats();
+
+// Fill ts with (at most max) timers pending on the calling core, in no
+// particular order, and return their number.
+u64 twheel_pending(wtimer **ts, u64 max);
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <types.h>
+#include <kernel/hvc.h>
+
+// Virtual UART: trap-and-emulate of the mini UART (UART1) at EL2.
+//
+// The page of the auxiliaries (see "bcm2837/auxiliaries.h") is unmapped at
+// stage 2, so that all accesses of EL1 to the UART registers trap to EL2:
+// - writes to AUX_MU_IO_REG are queued in a buffer of the calling core,
+// - reads of AUX_MU_LSR_REG always report the transmitter as empty and idle
+//   (with the receive bits of the real register), so that EL1 never waits,
+// - other accesses (including input) are performed on the real UART.
+//
+// Buffers are flushed to the real UART in batches, on each trap: a core takes
+// the (EL2) lock of the UART, and writes buffered characters for as long as
+// the transmit FIFO accepts them, without waiting. A core keeps writing the
+// buffer of the same core until the end of a line, so that lines are not
+// interleaved. EL1 only waits for the UART when its buffer is full.
+//
+// Note: the functions of this module run at EL2.
+
+// Size of the buffer of each core (in characters).
+#define VUART_BUFFER_SIZE 1024
+
+// Operations of the HVC_VUART_CTL hypercall (given in x1).
+#define VUART_OFF   0 // Flush the buffers, and give EL1 direct access.
+#define VUART_ON    1 // Trap and emulate the accesses of EL1.
+#define VUART_FLUSH 2 // Write all buffered characters (waiting for the UART).
+#define VUART_STATE 3 // Returns 1 if accesses are trapped, and 0 otherwise.
+
+// Initialise the buffers, and start trapping the UART accesses of EL1. Must be
+// called at EL2 by the main core, after "stage2_init".
+void vuart_init();
+
+// Unmap the UART again if it is emulated (after the mappings of the peripherals
+// were changed by another module, see "kernel/mmiotrace.h").
+void vuart_remap();
+
+// Handle a data abort taken to EL2 from EL1, with the given syndrome (ESR_EL2).
+// Returns false if the abort is not an access to the emulated UART.
+bool vuart_data_abort(hvc_frame *f, u64 esr);
+
+// Perform the given operation (one of the VUART_* constants, except VUART_STATE
+// which is handled by the hypercall). Returns false for invalid operations.
+bool vuart_ctl(u64 op);
+
+// Indicates whether the accesses of EL1 are trapped.
+bool vuart_emulating();
+
+// Statistics (for all cores).
+typedef struct {
+  u64 nb_traps;   // Trapped accesses.
+  u64 nb_chars;   // Characters written by EL1.
+  u64 nb_batches; // Batches of characters written to the real UART.
+  u64 max_batch;  // Size of the largest batch.
+} vuart_stats;
+
+void vuart_get_stats(vuart_stats *s);
@@ -0,0 +1,64 @@
+#pragma once
+#include <types.h>
+
+// Work-stealing task scheduler.
+//
+// Each core of the pool owns a Chase-Lev deque of tasks: it pushes and takes
+// tasks at the bottom of its own deque, while idle cores steal from the top of
+// the deques of other cores. A task covers a range of indices, and a core that
+// runs a task first splits it in halves (pushing the upper half to its deque)
+// until the range is no larger than the task's grain.
+
+// Type of the functions run by tasks, on the range [begin, end).
+typedef void (*range_fn)(u64 begin, u64 end, void *arg);
+
+// A task group tracks spawned tasks, so that they can be waited for.
+typedef struct {
+  volatile u64 pending; // Number of spawned tasks that have not completed.
+} task_group;
+
+// A task (stored by value in the deques).
+typedef struct {
+  range_fn fn;       // Function to run on sub-ranges.
+  void *arg;         // Argument given to fn.
+  u64 begin;         // Start of the range (inclusive).
+  u64 end;           // End of the range (exclusive).
+  u64 grain;         // Size under which the range is no longer split.
+  task_group *group; // Group the task belongs to.
+} task;
+
+// Set the number of cores of the pool (cores 0 to n-1), clamped between 1 and
+// NB_CORES. Only has an effect on subsequent calls to "wsched_start".
+void wsched_set_cores(u64 n);
+
+// Number of cores of the pool.
+u64 wsched_cores();
+
+// Start the pool: cores 1 to n-1 (where n is the size of the pool) start to
+// run, and steal, tasks. Calls can be nested (with as many "wsched_stop").
+void wsched_start();
+
+// Stop the pool (all the task groups must have been waited for).
+void wsched_stop();
+
+// Initialise a task group.
+void task_group_init(task_group *g);
+
+// Spawn a task running fn on [begin, end) as part of group g.
+void task_spawn(task_group *g, range_fn fn, u64 begin, u64 end, u64 grain,
+                void *arg);
+
+// Wait for all the tasks of group g to complete. The caller runs (and steals)
+// tasks while waiting.
+void task_group_wait(task_group *g);
+
+// Run fn on sub-ranges of at most grain indices covering [begin, end), using
+// all the cores of the pool. Returns once all the sub-ranges are processed.
+void parallel_for(u64 begin, u64 end, u64 grain, range_fn fn, void *arg);
+
+// Number of tasks run and stolen by the given core since the last reset.
+u64 wsched_nb_tasks(u64 core);
+u64 wsched_nb_steals(u64 core);
+
+// Reset the above statistics.
+void wsched_reset_stats();
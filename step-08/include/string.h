@@ -1,6 +1,14 @@
+#include <stddef.h>
+
 // Functions from the C standard library.
 
 char *strtok(char *str, const char *delim);
 char *strtok_r(char *str, const char *delim, char **saveptr);
 
 int strcmp(const char *s1, const char *s2);
+
+// Note: GCC may generate calls to the following functions (e.g., for copying
+// large structures) even in freestanding mode, so they must be provided.
+
+void *memcpy(void *dest, const void *src, size_t n);
+void *memset(void *s, int c, size_t n);
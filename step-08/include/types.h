@@ -6,3 +6,12 @@ typedef uint64_t u64;
 
 // Short name for the type of unsigned, 32-bits integers.
 typedef uint32_t u32;
+
+// Short name for the type of unsigned, 16-bits integers.
+typedef uint16_t u16;
+
+// Short name for the type of unsigned, 8-bits integers (bytes).
+typedef uint8_t u8;
+
+// Short name for the type of signed, 64-bits integers.
+typedef int64_t i64;
@@ -0,0 +1,189 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <macros.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <aarch64/cache.h>
+#include <bcm2837/local.h>
+#include <kernel/ipi.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
+
+// States of a call slot.
+#define CALL_IDLE    0 // The slot is free.
+#define CALL_CLAIMED 1 // A sender is filling in the slot.
+#define CALL_PENDING 2 // The target should run (or is running) the function.
+
+// Call slot, for calls from a given core to another, on its own cache line.
+typedef struct {
+  volatile u64 state; // One of the CALL_* constants.
+  smp_fn fn;          // Function to run.
+  void *arg;          // Argument to pass to the function.
+} __attribute__((aligned(CACHE_LINE_SIZE))) call_slot;
+
+// Call slots, indexed by target core and sender core.
+static call_slot calls[NB_CORES][NB_CORES];
+
+// Number of IPIs received by the core.
+static DEFINE_PER_CPU(u64, nb_received);
+
+// IPI handler: run the pending calls.
+static void ipi_irq(void *arg){
+  UNUSED(arg);
+  u64 core = smp_core_id();
+
+  u32 senders = *LOCAL_MAILBOX_RDCLR(core, IPI_MAILBOX);
+  *LOCAL_MAILBOX_RDCLR(core, IPI_MAILBOX) = senders;
+  dmb_ish();
+
+  for(u64 src = 0; src < NB_CORES; src++){
+    if(!(senders & BIT_U32(src))) continue;
+
+    call_slot *slot = &(calls[core][src]);
+    if(atomic_load_acquire(&slot->state) != CALL_PENDING) continue;
+
+    (*this_cpu_ptr(nb_received))++;
+    slot->fn(slot->arg);
+    atomic_store_release(&slot->state, CALL_IDLE);
+    sev();
+  }
+}
+
+void ipi_init_core(){
+  u64 core = smp_core_id();
+  irq_register(IRQ_MAILBOX(IPI_MAILBOX), "ipi", ipi_irq, NULL);
+
+  // Clear stale messages, and enable the IRQ for our mailbox.
+  *LOCAL_MAILBOX_RDCLR(core, IPI_MAILBOX) = UINT32_MAX;
+  *LOCAL_MAILBOX_IRQ_CNTL(core) |= BIT_U32(IPI_MAILBOX);
+}
+
+// Wait for the slot to become idle.
+static void wait_idle(call_slot *slot){
+  while(atomic_load_acquire(&slot->state) != CALL_IDLE){
+    wfe();
+  }
+}
+
+bool smp_call_function_async(u64 core, smp_fn fn, void *arg){
+  if(core >= NB_CORES || !smp_is_online(core)) return false;
+
+  u64 self = smp_core_id();
+  if(core == self){
+    u64 flags = irq_save();
+    fn(arg);
+    irq_restore(flags);
+    return true;
+  }
+
+  // Claim our slot on the target (it may be used by a previous call).
+  call_slot *slot = &(calls[core][self]);
+  while(!atomic_cas(&slot->state, CALL_IDLE, CALL_CLAIMED)){
+    u64 state = atomic_load_acquire(&slot->state);
+    if(state == CALL_PENDING){
+      // The target releases the slot (and signals an event) once done.
+      wfe();
+    } else if(state == CALL_CLAIMED){
+      // Another thread of our core is filling in the slot: it must run.
+      if(irq_masked()) return false;
+      thread_yield();
+    }
+  }
+
+  slot->fn  = fn;
+  slot->arg = arg;
+  atomic_store_release(&slot->state, CALL_PENDING);
+
+  // Make sure the slot is visible before the interrupt is raised.
+  dsb_ish();
+  *LOCAL_MAILBOX_SET(core, IPI_MAILBOX) = BIT_U32(self);
+  return true;
+}
+
+bool smp_call_function(u64 core, smp_fn fn, void *arg){
+  if(!smp_call_function_async(core, fn, arg)) return false;
+  smp_call_wait(core);
+  return true;
+}
+
+void smp_call_wait(u64 core){
+  u64 self = smp_core_id();
+  if(core >= NB_CORES || core == self) return;
+  wait_idle(&(calls[core][self]));
+}
+
+u64 ipi_nb_received(u64 core){
+  if(core >= NB_CORES) return 0;
+  return *per_cpu_ptr(nb_received, core);
+}
+
+void shootdown_init(shootdown_batch *b){
+  b->nb_ops = 0;
+}
+
+bool shootdown_add(shootdown_batch *b, u64 op, u64 addr, u64 size){
+  if(b->nb_ops >= SHOOTDOWN_MAX_OPS) return false;
+  b->ops[b->nb_ops].op   = op;
+  b->ops[b->nb_ops].addr = addr;
+  b->ops[b->nb_ops].size = size;
+  b->nb_ops++;
+  return true;
+}
+
+// Perform the operations of a batch on the calling core. Non-broadcast TLB
+// invalidation instructions are used, since each target does its own work.
+static void shootdown_local(void *arg){
+  shootdown_batch *b = (shootdown_batch *) arg;
+
+  for(u64 i = 0; i < b->nb_ops; i++){
+    u64 addr = b->ops[i].addr;
+    u64 size = b->ops[i].size;
+
+    switch(b->ops[i].op){
+      case SHOOTDOWN_TLB_ALL:
+        asm volatile("tlbi vmalle1" : : : "memory");
+        break;
+      case SHOOTDOWN_TLB_VA:
+        for(u64 va = addr & ~0xfffULL; va < addr + size; va += 0x1000){
+          asm volatile("tlbi vae1, %0" : : "r" (va >> 12) : "memory");
+        }
+        break;
+      case SHOOTDOWN_DCACHE:
+        dcache_clean_inval_range((void *) addr, size);
+        break;
+      case SHOOTDOWN_ICACHE:
+        asm volatile("ic iallu" : : : "memory");
+        break;
+      default:
+        break;
+    }
+  }
+
+  asm volatile("dsb nsh; isb" : : : "memory");
+}
+
+u64 smp_shootdown(u64 core_mask, shootdown_batch *b){
+  u64 self = smp_core_id();
+  u64 done = 0;
+
+  // Send all the IPIs first, so that the targets work in parallel.
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(core == self || !((core_mask >> core) & 1)) continue;
+    if(smp_call_function_async(core, shootdown_local, b)) done |= 1ULL << core;
+  }
+
+  if((core_mask >> self) & 1){
+    u64 flags = irq_save();
+    shootdown_local(b);
+    irq_restore(flags);
+    done |= 1ULL << self;
+  }
+
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(core != self && ((done >> core) & 1)) smp_call_wait(core);
+  }
+
+  return done;
+}
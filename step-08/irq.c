@@ -0,0 +1,246 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <macros.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/armctrl.h>
+#include <bcm2837/local.h>
+#include <bcm2837/uart1.h>
+#include <kernel/hvc.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
+#include <kernel/vuart.h>
+
+// Exception vector (defined in "vectors.S").
+extern char el1_exception_vector[];
+
+// Names of the entries of the exception vector.
+static const char *vector_entry_names[16] = {
+  "synchronous (current EL, SP0)", "IRQ (current EL, SP0)",
+  "FIQ (current EL, SP0)",         "SError (current EL, SP0)",
+  "synchronous (current EL, SPx)", "IRQ (current EL, SPx)",
+  "FIQ (current EL, SPx)",         "SError (current EL, SPx)",
+  "synchronous (lower EL, A64)",   "IRQ (lower EL, A64)",
+  "FIQ (lower EL, A64)",           "SError (lower EL, A64)",
+  "synchronous (lower EL, A32)",   "IRQ (lower EL, A32)",
+  "FIQ (lower EL, A32)",           "SError (lower EL, A32)"
+};
+
+// Registered handlers.
+typedef struct {
+  irq_handler fn;
+  void *arg;
+  const char *name;
+} irq_descr;
+
+static irq_descr handlers[NB_IRQS];
+
+// Per-core state of the dispatcher.
+typedef struct {
+  bool in_handler;           // Is an IRQ handler running?
+  u64 entry;                 // Time at which the current IRQ was taken.
+  exception_frame *frame;    // Registers saved when it was taken.
+  u64 nb_spurious;           // Number of IRQs without handler.
+  irq_stats stats[NB_IRQS];  // Statistics for each IRQ.
+} irq_core;
+
+static DEFINE_PER_CPU(irq_core, irq_core_data);
+
+void irq_init(){
+  write_vbar_el1((u64) el1_exception_vector);
+  isb();
+}
+
+bool irq_register(u64 irq, const char *name, irq_handler fn, void *arg){
+  if(irq >= NB_IRQS || fn == NULL) return false;
+
+  u64 flags = irq_save();
+  irq_descr *d = &(handlers[irq]);
+  bool ok = d->fn == NULL || (d->fn == fn && d->arg == arg);
+  if(ok){
+    d->name = name;
+    d->arg  = arg;
+    d->fn   = fn;
+  }
+  irq_restore(flags);
+
+  return ok;
+}
+
+void irq_unregister(u64 irq){
+  if(irq >= NB_IRQS) return;
+  irq_mask_source(irq);
+
+  u64 flags = irq_save();
+  handlers[irq].fn = NULL;
+  handlers[irq].arg = NULL;
+  handlers[irq].name = NULL;
+  irq_restore(flags);
+}
+
+void irq_unmask_source(u64 irq){
+  if(irq >= IRQ_ARM(0) && irq < NB_IRQS){
+    *ENABLE_BASIC_IRQS = BIT_U32(irq - IRQ_ARM(0));
+  } else if(irq >= IRQ_GPU(32) && irq < IRQ_ARM(0)){
+    *ENABLE_IRQS_2 = BIT_U32(irq - IRQ_GPU(32));
+  } else if(irq >= IRQ_GPU(0) && irq < IRQ_GPU(32)){
+    *ENABLE_IRQS_1 = BIT_U32(irq - IRQ_GPU(0));
+  }
+}
+
+void irq_mask_source(u64 irq){
+  if(irq >= IRQ_ARM(0) && irq < NB_IRQS){
+    *DISABLE_BASIC_IRQS = BIT_U32(irq - IRQ_ARM(0));
+  } else if(irq >= IRQ_GPU(32) && irq < IRQ_ARM(0)){
+    *DISABLE_IRQS_2 = BIT_U32(irq - IRQ_GPU(32));
+  } else if(irq >= IRQ_GPU(0) && irq < IRQ_GPU(32)){
+    *DISABLE_IRQS_1 = BIT_U32(irq - IRQ_GPU(0));
+  }
+}
+
+const char *irq_name(u64 irq){
+  if(irq >= NB_IRQS || handlers[irq].fn == NULL) return NULL;
+  return handlers[irq].name;
+}
+
+bool irq_in_handler(){
+  return this_cpu_ptr(irq_core_data)->in_handler;
+}
+
+u64 irq_entry_ticks(){
+  return this_cpu_ptr(irq_core_data)->entry;
+}
+
+const exception_frame *irq_frame(){
+  return this_cpu_ptr(irq_core_data)->frame;
+}
+
+void irq_record_latency(u64 irq, u64 ticks){
+  if(irq >= NB_IRQS) return;
+  irq_stats *s = &(this_cpu_ptr(irq_core_data)->stats[irq]);
+  s->lat_count++;
+  s->lat_total += ticks;
+  if(ticks > s->lat_max) s->lat_max = ticks;
+}
+
+void irq_get_stats(u64 irq, u64 core, irq_stats *s){
+  *s = per_cpu_ptr(irq_core_data, core)->stats[irq];
+}
+
+void irq_reset_stats(){
+  for(u64 core = 0; core < NB_CORES; core++){
+    irq_core *ic = per_cpu_ptr(irq_core_data, core);
+    ic->nb_spurious = 0;
+    for(u64 irq = 0; irq < NB_IRQS; irq++){
+      irq_stats *s = &(ic->stats[irq]);
+      s->count = 0;
+      s->time_total = 0;
+      s->time_max = 0;
+      s->lat_count = 0;
+      s->lat_total = 0;
+      s->lat_max = 0;
+    }
+  }
+}
+
+u64 irq_nb_spurious(u64 core){
+  return per_cpu_ptr(irq_core_data, core)->nb_spurious;
+}
+
+// Print information about an exception, and hang.
+static void fatal_exception(exception_frame *f, u64 index){
+  uart1_printf("\n**Fatal exception on core %u: %s.**\n",
+               smp_core_id(), vector_entry_names[index & 0xf]);
+  uart1_printf("ESR_EL1: 0x%w\n", read_esr_el1());
+  uart1_printf("FAR_EL1: 0x%w\n", read_far_el1());
+  uart1_printf("ELR_EL1: 0x%w\n", f->elr);
+  uart1_printf("SPSR:    0x%w\n", f->spsr);
+
+  // Characters still buffered by the virtual UART would never be written.
+  hvc_call(HVC_VUART_CTL, VUART_FLUSH, 0, 0);
+  while(1){
+    asm volatile("wfe");
+  }
+}
+
+// Synchronous exceptions (faults, ...) taken at EL1 (called from "vectors.S").
+void el1_sync_handler(exception_frame *f, u64 index){
+  fatal_exception(f, index);
+}
+
+// Run the handler of the given IRQ, and account for it.
+static void dispatch(irq_core *ic, u64 irq){
+  irq_descr *d = &(handlers[irq]);
+  if(d->fn == NULL){
+    // Mask GPU sources without handler, to avoid an interrupt storm.
+    ic->nb_spurious++;
+    irq_mask_source(irq);
+    return;
+  }
+
+  u64 start = counter_ticks();
+  d->fn(d->arg);
+  u64 time = counter_ticks() - start;
+
+  irq_stats *s = &(ic->stats[irq]);
+  s->count++;
+  s->time_total += time;
+  if(time > s->time_max) s->time_max = time;
+}
+
+// Dispatch the pending GPU and ARM-specific IRQs (second level).
+static void dispatch_gpu(irq_core *ic){
+  u32 basic = *IRQ_BASIC_PENDING & IRQ_BASIC_ARM_MASK;
+  u32 pending1 = *IRQ_PENDING_1;
+  u32 pending2 = *IRQ_PENDING_2;
+
+  while(basic){
+    u64 n = __builtin_ctz(basic);
+    basic &= basic - 1;
+    dispatch(ic, IRQ_ARM(n));
+  }
+  while(pending1){
+    u64 n = __builtin_ctz(pending1);
+    pending1 &= pending1 - 1;
+    dispatch(ic, IRQ_GPU(n));
+  }
+  while(pending2){
+    u64 n = __builtin_ctz(pending2);
+    pending2 &= pending2 - 1;
+    dispatch(ic, IRQ_GPU(32 + n));
+  }
+}
+
+// IRQs taken at EL1 (called from "vectors.S"). Local sources are dispatched
+// first (first level), and the GPU source then leads to the BCM2835 interrupt
+// controller (second level).
+void el1_irq_handler(exception_frame *f, u64 index){
+  UNUSED(index);
+
+  irq_core *ic = this_cpu_ptr(irq_core_data);
+  ic->entry = counter_ticks();
+  ic->frame = f;
+  ic->in_handler = true;
+
+  u32 source = *LOCAL_IRQ_SOURCE(smp_core_id()) & MASK_U32(0, 12);
+  while(source){
+    u64 n = __builtin_ctz(source);
+    source &= source - 1;
+    if(IRQ_LOCAL(n) == IRQ_GPU_SOURCE){
+      dispatch_gpu(ic);
+    } else {
+      dispatch(ic, IRQ_LOCAL(n));
+    }
+  }
+
+  // The scheduler may switch to another thread if a handler asked for it.
+  ic->in_handler = false;
+  sched_irq_exit();
+}
+
+// Exceptions that should never happen (called from "vectors.S").
+void el1_unexpected_handler(exception_frame *f, u64 index){
+  fatal_exception(f, index);
+}
@@ -4,17 +4,46 @@
 #include <limits.h>
 #include <string.h>
 #include <util.h>
+#include <crc32.h>
+#include <aarch64/pmu.h>
+#include <kernel/clock.h>
+#include <kernel/ipi.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
 #include <kernel/shell.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/twheel.h>
+
+// Thread running the interactive shell.
+static void shell_thread(void *arg){
+  UNUSED(arg);
+  shell_main(); // Never returns.
+}
+
 
 // Entry point for the kernel, allocated in the ".text" segment.
 // This function never returns.
 void kernel_entry(void *dtb, u64 x1, u64 x2, u64 x3, u64 x4, u64 x5, u64 x6){
+  // Set up the per-core data of the main core (used by the scheduler, which
+  // may be called by the UART driver).
+  percpu_init_core();
+
   // Initialise the UART, and print a first message.
   uart1_init();
   uart1_puts("********************************************\n");
   uart1_puts("*              Hello, World!!              *\n");
   uart1_puts("********************************************\n");
 
+  // Install the exception vector, and enable IPIs (IRQs remain masked for now).
+  irq_init();
+  ipi_init_core();
+
+  // Set up the per-core timer, and its timer wheel.
+  timer_init_core();
+  twheel_init_core();
+
   // Print information about the environment.
   uart1_printf("Initial value of x1:     0x%w.\n", x1);
   uart1_printf("Initial value of x2:     0x%w.\n", x2);
@@ -29,7 +58,21 @@ void kernel_entry(void *dtb, u64 x1, u64 x2, u64 x3, u64 x4, u64 x5, u64 x6){
     uart1_printf("n/a\n");
   }
 
-  // Enter the (infinite) shell loop.
+  uart1_printf("Clock source:            %s (%u Hz, %u loops/ms).\n",
+               clock_source() == CLOCK_GENERIC_TIMER ? "generic timer"
+                                                     : "system timer",
+               clock_freq(), clock_loops_per_ms());
+
+  // Wake up the secondary cores.
+  smp_init();
+  uart1_printf("Number of online cores:  %u.\n", smp_nb_online());
+
+  // Initialise other subsystems.
+  pmu_enable();
+  crc32_init();
+
+  // Start the shell thread, and become the idle thread.
   uart1_puts("Entering the interactive mode.\n");
-  shell_main(); // Never returns.
+  thread_create("shell", PRIO_DEFAULT, shell_thread, NULL);
+  sched_start(); // Never returns.
 }
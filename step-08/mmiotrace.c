@@ -0,0 +1,173 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <kernel/mmiotrace.h>
+#include <kernel/smp.h>
+#include <kernel/stage2.h>
+#include <kernel/vuart.h>
+
+// Physical address range of the BCM2837 peripherals.
+#define PERIPHERALS_BASE 0x3f000000ULL
+#define PERIPHERALS_SIZE 0x01000000ULL
+
+// Maximum number of slots probed when recording an access.
+#define MAX_PROBES 16
+
+// Tables and logs of each core (in the memory private to EL2). Tables are open
+// addressing hash tables indexed by register and site.
+static mmiotrace_site sites[NB_CORES][MMIOTRACE_SITES]
+  __attribute__((section(".hyp")));
+static mmiotrace_access logs[NB_CORES][MMIOTRACE_LOG]
+  __attribute__((section(".hyp")));
+
+// State of each core (also in the memory private to EL2).
+typedef struct {
+  bool used;     // Were the table and the log initialised?
+  u64 nb_logged; // Number of accesses written to the log (free-running).
+  mmiotrace_stats stats;
+} __attribute__((aligned(64))) core_state;
+
+static core_state cores[NB_CORES] __attribute__((section(".hyp")));
+
+static volatile u64 tracing __attribute__((section(".hyp")));
+
+static void record(u64 core, u64 addr, u64 pc, u64 value, u64 size,
+                   bool write){
+  core_state *c = &(cores[core]);
+  c->stats.nb_traps++;
+
+  mmiotrace_access *a = &(logs[core][c->nb_logged++ % MMIOTRACE_LOG]);
+  a->addr = addr;
+  a->pc = pc;
+  a->value = value;
+  a->size = size | (write ? MMIOTRACE_WRITE : 0);
+
+  // Registers and instructions are 4-byte aligned (in practice).
+  u64 i = ((addr >> 2) ^ (pc >> 2) * 31) % MMIOTRACE_SITES;
+  for(u64 k = 0; k < MAX_PROBES; k++){
+    mmiotrace_site *s = &(sites[core][(i + k) % MMIOTRACE_SITES]);
+    if(s->reads + s->writes == 0){
+      s->addr = addr;
+      s->pc = pc;
+    }
+    if(s->addr == addr && s->pc == pc){
+      if(write){
+        s->writes++;
+      } else {
+        s->reads++;
+      }
+      return;
+    }
+  }
+  c->stats.nb_dropped++;
+}
+
+static void reset(u64 core){
+  core_state *c = &(cores[core]);
+  for(u64 i = 0; i < MMIOTRACE_SITES; i++){
+    sites[core][i].reads = 0;
+    sites[core][i].writes = 0;
+  }
+  c->nb_logged = 0;
+  c->stats.nb_traps = 0;
+  c->stats.nb_dropped = 0;
+  c->stats.stopped_pc = 0;
+  c->used = true;
+}
+
+bool mmiotrace_ctl(u64 op){
+  switch(op){
+    case MMIOTRACE_STOP:
+      if(!tracing) return true;
+      // Accesses trapping until the peripherals are mapped again are still
+      // emulated (later ones are performed again, see "stage2_data_abort").
+      stage2_protect(PERIPHERALS_BASE, PERIPHERALS_SIZE, S2_RW);
+      vuart_remap();
+      tracing = 0;
+      return true;
+    case MMIOTRACE_START:
+      if(tracing) return true;
+      for(u64 core = 0; core < NB_CORES; core++) reset(core);
+      tracing = 1;
+      return stage2_protect(PERIPHERALS_BASE, PERIPHERALS_SIZE, S2_NONE);
+    default:
+      return false;
+  }
+}
+
+void mmiotrace_remap(){
+  if(tracing) stage2_protect(PERIPHERALS_BASE, PERIPHERALS_SIZE, S2_NONE);
+}
+
+bool mmiotrace_data_abort(hvc_frame *f, u64 esr){
+  if(!tracing) return false;
+  u64 ipa = stage2_fault_ipa();
+  if(ipa < PERIPHERALS_BASE || ipa >= PERIPHERALS_BASE + PERIPHERALS_SIZE){
+    return false;
+  }
+
+  // Accesses that cannot be emulated stop tracing, and are performed again.
+  if(!(esr & ISS_ISV) || (esr & ISS_CM)){
+    cores[smp_core_id()].stats.stopped_pc = f->elr;
+    mmiotrace_ctl(MMIOTRACE_STOP);
+    return true;
+  }
+
+  u64 size = 1ULL << ISS_SAS(esr);
+  u64 rt = ISS_SRT(esr);
+  bool write = esr & ISS_WNR;
+  u64 v = 0;
+
+  if(write){
+    v = rt == 31 ? 0 : f->x[rt];
+    switch(size){
+      case 1: *((volatile u8 *) ipa) = (u8) v; break;
+      case 2: *((volatile u16 *) ipa) = (u16) v; break;
+      case 4: *((volatile u32 *) ipa) = (u32) v; break;
+      default: *((volatile u64 *) ipa) = v; break;
+    }
+  } else {
+    switch(size){
+      case 1: v = *((volatile u8 *) ipa); break;
+      case 2: v = *((volatile u16 *) ipa); break;
+      case 4: v = *((volatile u32 *) ipa); break;
+      default: v = *((volatile u64 *) ipa); break;
+    }
+    u64 r = v;
+    if((esr & ISS_SSE) && size < 8 && (v >> (8 * size - 1)) & 1){
+      r |= ~0ULL << (8 * size);
+    }
+    if(!(esr & ISS_SF)) r &= 0xffffffffULL;
+    if(rt != 31) f->x[rt] = r;
+  }
+
+  record(smp_core_id(), ipa, f->elr, v, size, write);
+  f->elr += 4;
+  return true;
+}
+
+u64 mmiotrace_read_sites(u64 core, mmiotrace_site *buf, u64 max){
+  if(core >= NB_CORES || !cores[core].used) return 0;
+  u64 n = 0;
+  for(u64 i = 0; i < MMIOTRACE_SITES && n < max; i++){
+    mmiotrace_site *s = &(sites[core][i]);
+    if(s->reads + s->writes == 0) continue;
+    buf[n++] = *s;
+  }
+  return n;
+}
+
+u64 mmiotrace_read_log(u64 core, mmiotrace_access *buf, u64 max){
+  if(core >= NB_CORES || !cores[core].used) return 0;
+  u64 logged = cores[core].nb_logged;
+  u64 n = logged < MMIOTRACE_LOG ? logged : MMIOTRACE_LOG;
+  if(n > max) n = max;
+  for(u64 i = 0; i < n; i++){
+    buf[i] = logs[core][(logged - n + i) % MMIOTRACE_LOG];
+  }
+  return n;
+}
+
+void mmiotrace_get_stats(u64 core, mmiotrace_stats *s){
+  *s = cores[core].stats;
+}
@@ -0,0 +1,91 @@
+#include <stdbool.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <kernel/mmu.h>
+
+// We use 4KB translation granules and 39-bit virtual addresses, so that table
+// walks start at level 1 (each level-1 entry covers 1GB). The first entry is
+// a level-2 table covering 0x00000000 to 0x3fffffff with 2MB blocks (normal
+// memory below 0x3f000000, device memory for the peripherals above), and the
+// second entry maps 0x40000000 to 0x7fffffff (ARM local peripherals) as a 1GB
+// device memory block.
+
+// Start of the BCM2837 peripherals in the physical address space.
+#define PERIPHERALS_BASE 0x3f000000ULL
+
+// Fields of block and table descriptors.
+#define DESC_BLOCK    0x1ULL
+#define DESC_TABLE    0x3ULL
+#define DESC_ATTR(i)  (((u64) (i)) << 2)
+#define DESC_AP_EL2   (1ULL << 6)  // AP[1] must be 1 in the EL2 regime.
+#define DESC_SH_INNER (3ULL << 8)
+#define DESC_AF       (1ULL << 10) // Access flag (or we get a fault).
+#define DESC_PXN      (1ULL << 53) // Not executable at EL1 (RES0 at EL2).
+#define DESC_XN       (1ULL << 54) // Not executable at EL0 (or at EL2).
+
+// Memory attributes: index 0 is Device-nGnRnE (0x00), index 1 is normal write
+// back read/write-allocate memory (0xff), index 2 is normal non-cacheable memory
+// (0x44). See the MT_* constants of "include/kernel/mmu.h".
+#define MAIR_VALUE 0x44ff00ULL
+
+// Translation control: T0SZ = 25 (39-bit addresses), walks are inner/outer
+// write-back cacheable and inner shareable, 4KB granule. At EL1, TTBR1 walks
+// are disabled (EPD1), and at EL2 bits 31 and 23 are RES1.
+#define TCR_COMMON    (25ULL | (1ULL << 8) | (1ULL << 10) | (3ULL << 12))
+#define TCR_EL1_VALUE (TCR_COMMON | (1ULL << 23))
+#define TCR_EL2_VALUE (TCR_COMMON | (1ULL << 23) | (1ULL << 31))
+
+// Reserved bits of the SCTLR_ELx registers. We write complete values (reserved
+// bits set to 1 as required), rather than relying on the UNKNOWN reset values
+// for other fields (e.g., alignment checking or endianness).
+#define SCTLR_EL1_RES1 0x30d00800ULL
+#define SCTLR_EL2_RES1 0x30c50830ULL
+
+// Translation tables (512 entries of 8 bytes, aligned on 4KB).
+static u64 el1_l1[512] __attribute__((aligned(4096)));
+static u64 el1_l2[512] __attribute__((aligned(4096)));
+static u64 el2_l1[512] __attribute__((aligned(4096)));
+static u64 el2_l2[512] __attribute__((aligned(4096)));
+
+// Fill in the (identity mapping) tables, as described above.
+// Note: tables are written before the MMU is enabled, so they go to RAM.
+static void build_tables(u64 *l1, u64 *l2, bool el2){
+  u64 ap = el2 ? DESC_AP_EL2 : 0;
+  u64 xn = el2 ? DESC_XN : DESC_PXN | DESC_XN;
+  u64 normal = DESC_BLOCK | DESC_ATTR(MT_NORMAL) | DESC_SH_INNER | DESC_AF;
+  u64 device = DESC_BLOCK | DESC_ATTR(MT_DEVICE) | DESC_AF | xn;
+
+  for(u64 i = 0; i < 512; i++){
+    u64 addr = i << 21;
+    l2[i] = addr | ap | (addr < PERIPHERALS_BASE ? normal : device);
+  }
+
+  l1[0] = (u64) l2 | DESC_TABLE;
+  l1[1] = (1ULL << 30) | ap | device;
+  for(u64 i = 2; i < 512; i++){
+    l1[i] = 0;
+  }
+}
+
+void mmu_init(){
+  build_tables(el1_l1, el1_l2, false);
+  build_tables(el2_l1, el2_l2, true);
+  mmu_enable();
+}
+
+void mmu_enable(){
+  // Configure the EL1 translation regime (used after the move to EL1).
+  write_mair_el1(MAIR_VALUE);
+  write_tcr_el1(TCR_EL1_VALUE);
+  write_ttbr0_el1((u64) el1_l1);
+  write_sctlr_el1(SCTLR_EL1_RES1 | SCTLR_M | SCTLR_C | SCTLR_I);
+
+  // Configure and enable the EL2 translation regime.
+  write_mair_el2(MAIR_VALUE);
+  write_tcr_el2(TCR_EL2_VALUE);
+  write_ttbr0_el2((u64) el2_l1);
+  asm volatile("dsb sy; tlbi alle2; tlbi alle1; ic iallu; dsb sy; isb"
+               : : : "memory");
+  write_sctlr_el2(SCTLR_EL2_RES1 | SCTLR_M | SCTLR_C | SCTLR_I);
+  isb();
+}
@@ -0,0 +1,28 @@
+#include <string.h>
+#include <types.h>
+#include <aarch64/cache.h>
+#include <aarch64/sysreg.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+
+// Bounds of the ".percpu" template, and start of the per-core copies (defined
+// in "kernel8.ld").
+extern char __percpu_start[];
+extern char __percpu_end[];
+extern char __percpu_copies[];
+
+// Size of a copy (the template is cache-line aligned in "kernel8.ld").
+static u64 percpu_size(){
+  return (u64) (__percpu_end - __percpu_start);
+}
+
+u64 percpu_offset_of(u64 core){
+  return (u64) (__percpu_copies - __percpu_start) + core * percpu_size();
+}
+
+void percpu_init_core(){
+  u64 offset = percpu_offset_of(smp_core_id());
+  memcpy(__percpu_start + offset, __percpu_start, percpu_size());
+  write_tpidr_el1(offset);
+  isb();
+}
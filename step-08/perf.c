@@ -0,0 +1,111 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/pmu.h>
+#include <aarch64/sysreg.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/perf.h>
+
+// Session running on each core (if any).
+static DEFINE_PER_CPU(perf_session *, running);
+
+u64 perf_nb_groups(const perf_session *s){
+  return (s->nb_events + s->nb_counters - 1) / s->nb_counters;
+}
+
+// Index of the first event of the current group, and number of events.
+static u64 group_first(const perf_session *s){
+  return s->group * s->nb_counters;
+}
+
+static u64 group_size(const perf_session *s){
+  u64 left = s->nb_events - group_first(s);
+  return left < s->nb_counters ? left : s->nb_counters;
+}
+
+// Program the counters with the events of the current group, and start them.
+static void group_start(perf_session *s){
+  u64 first = group_first(s);
+  u64 n = group_size(s);
+  for(u64 i = 0; i < n; i++){
+    pmu_counter_setup(i, s->events[first + i]);
+  }
+  s->group_start = counter_ticks();
+  pmu_counters_start((1ULL << n) - 1);
+}
+
+// Stop the counters, and add their values to the counts of the group.
+static void group_stop(perf_session *s){
+  u64 first = group_first(s);
+  u64 n = group_size(s);
+  pmu_counters_stop((1ULL << n) - 1);
+  u64 ticks = counter_ticks() - s->group_start;
+  for(u64 i = 0; i < n; i++){
+    s->counts[first + i] += pmu_counter_read(i);
+    s->ticks[first + i] += ticks;
+  }
+}
+
+// Timer callback (with IRQs masked): switch to the next group.
+static void rotate(void *arg){
+  perf_session *s = (perf_session *) arg;
+  group_stop(s);
+  if(perf_nb_groups(s) > 1){
+    s->group = (s->group + 1) % perf_nb_groups(s);
+    s->nb_rotations++;
+  }
+  group_start(s);
+  wtimer_arm(&(s->timer), PERF_ROTATE_US);
+}
+
+bool perf_start(perf_session *s, const u64 *events, u64 n){
+  if(n == 0 || n > PERF_MAX_EVENTS) return false;
+  u64 nb_counters = pmu_nb_counters();
+  if(nb_counters == 0) return false;
+
+  u64 flags = irq_save();
+  if(this_cpu_read(running) != NULL){
+    irq_restore(flags);
+    return false;
+  }
+  this_cpu_write(running, s);
+
+  s->nb_events = n;
+  for(u64 i = 0; i < n; i++){
+    s->events[i] = events[i];
+    s->counts[i] = 0;
+    s->ticks[i] = 0;
+  }
+  s->nb_rotations = 0;
+  s->nb_counters = nb_counters;
+  s->group = 0;
+
+  wtimer_init(&(s->timer), rotate, s);
+  wtimer_arm(&(s->timer), PERF_ROTATE_US);
+  s->start_ticks = counter_ticks();
+  s->start_cycles = pmu_cycles();
+  group_start(s);
+  irq_restore(flags);
+  return true;
+}
+
+void perf_stop(perf_session *s){
+  u64 flags = irq_save();
+  group_stop(s);
+  s->cycles = pmu_cycles() - s->start_cycles;
+  s->total_ticks = counter_ticks() - s->start_ticks;
+  wtimer_cancel(&(s->timer));
+  this_cpu_write(running, NULL);
+  irq_restore(flags);
+}
+
+u64 perf_scaled(const perf_session *s, u64 i){
+  u64 c = s->counts[i];
+  u64 t = s->ticks[i];
+  if(t == 0) return 0;
+  if(t >= s->total_ticks) return c;
+
+  // Computes c * total / t without overflowing.
+  return (c / t) * s->total_ticks + (c % t) * s->total_ticks / t;
+}
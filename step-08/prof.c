@@ -0,0 +1,153 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/pmu.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/local.h>
+#include <kernel/prof.h>
+#include <kernel/smp.h>
+
+// Bit of HCR_EL2 routing physical FIQs to EL2.
+#define HCR_FMO (1ULL << 3)
+
+// Fields of MDCR_EL2: number of counters accessible from EL1, and enable bit of
+// the counters reserved for EL2.
+#define MDCR_HPMN_MASK 0x1fULL
+#define MDCR_HPME      (1ULL << 7)
+
+// Maximum number of slots probed when recording a PC.
+#define MAX_PROBES 16
+
+// Histogram of each core (in the memory private to EL2), as an open addressing
+// hash table indexed by PC.
+static prof_sample histograms[NB_CORES][PROF_SLOTS]
+  __attribute__((section(".hyp")));
+
+// Profiling state of each core.
+typedef struct {
+  bool running;
+  bool used;      // Was the histogram initialised?
+  u64 counter;    // Index of the event counter reserved for EL2.
+  u64 period;     // Sampling period (in cycles).
+  u64 nb_samples;
+  u64 nb_dropped;
+} __attribute__((aligned(64))) core_state;
+
+static core_state cores[NB_CORES] __attribute__((section(".hyp")));
+
+// Program the reserved counter so that it overflows after period cycles. The
+// counter selection of EL1 is preserved (it may be interrupted while using it).
+static void arm_counter(core_state *c){
+  u64 sel = read_pmselr_el0();
+  write_pmselr_el0(c->counter);
+  isb();
+  write_pmxevtyper_el0(PMEVTYPER_EVENT(PMU_EVENT_CPU_CYCLES));
+  write_pmxevcntr_el0((1ULL << 32) - c->period);
+  write_pmselr_el0(sel);
+  isb();
+}
+
+static void record(u64 core, u64 pc){
+  core_state *c = &(cores[core]);
+  prof_sample *h = histograms[core];
+  c->nb_samples++;
+
+  // Instructions are 4-byte aligned, so the low bits are not hashed.
+  u64 i = (pc >> 2) % PROF_SLOTS;
+  for(u64 k = 0; k < MAX_PROBES; k++){
+    prof_sample *s = &(h[(i + k) % PROF_SLOTS]);
+    if(s->count == 0) s->pc = pc;
+    if(s->pc == pc){
+      s->count++;
+      return;
+    }
+  }
+  c->nb_dropped++;
+}
+
+bool prof_start(u64 period){
+  u64 core = smp_core_id();
+  core_state *c = &(cores[core]);
+  if(period < PROF_MIN_PERIOD || period > PROF_MAX_PERIOD) return false;
+  u64 n = PMCR_N(read_pmcr_el0());
+  if(n == 0) return false;
+  if(c->running) prof_stop();
+
+  for(u64 i = 0; i < PROF_SLOTS; i++){
+    histograms[core][i].pc = 0;
+    histograms[core][i].count = 0;
+  }
+  c->counter = n - 1;
+  c->period = period;
+  c->nb_samples = 0;
+  c->nb_dropped = 0;
+  c->used = true;
+
+  // Reserve the last counter, and take the PMU interrupt as a FIQ.
+  write_mdcr_el2((read_mdcr_el2() & ~MDCR_HPMN_MASK) | c->counter | MDCR_HPME);
+  arm_counter(c);
+  write_pmovsclr_el0(1ULL << c->counter);
+  write_pmintenset_el1(1ULL << c->counter);
+  write_pmcntenset_el0(1ULL << c->counter);
+  write_hcr_el2(read_hcr_el2() | HCR_FMO);
+  *LOCAL_PMU_IRQ_SET = LOCAL_PMU_FIQ(core);
+  isb();
+  c->running = true;
+  return true;
+}
+
+void prof_stop(){
+  u64 core = smp_core_id();
+  core_state *c = &(cores[core]);
+  if(!c->running) return;
+
+  // Give all the counters back to EL1.
+  *LOCAL_PMU_IRQ_CLR = LOCAL_PMU_FIQ(core);
+  write_hcr_el2(read_hcr_el2() & ~HCR_FMO);
+  write_pmcntenclr_el0(1ULL << c->counter);
+  write_pmintenclr_el1(1ULL << c->counter);
+  write_pmovsclr_el0(1ULL << c->counter);
+  u64 n = PMCR_N(read_pmcr_el0());
+  write_mdcr_el2((read_mdcr_el2() & ~(MDCR_HPMN_MASK | MDCR_HPME)) | n);
+  isb();
+  c->running = false;
+}
+
+u64 prof_read(u64 core, prof_sample *buf, u64 max, u64 *nb_samples,
+              u64 *nb_dropped){
+  if(core >= NB_CORES) return 0;
+  core_state *c = &(cores[core]);
+  *nb_samples = c->nb_samples;
+  *nb_dropped = c->nb_dropped;
+
+  // Histograms are only initialised when profiling starts.
+  if(!c->used) return 0;
+
+  u64 n = 0;
+  for(u64 i = 0; i < PROF_SLOTS && n < max; i++){
+    prof_sample *s = &(histograms[core][i]);
+    if(s->count == 0) continue;
+    buf[n].pc = s->pc;
+    buf[n].count = s->count;
+    n++;
+  }
+  return n;
+}
+
+void prof_fiq(hvc_frame *f){
+  u64 core = smp_core_id();
+  core_state *c = &(cores[core]);
+  u64 bit = 1ULL << c->counter;
+
+  // The overflow interrupts of the counters of EL1 are also routed here while
+  // profiling (EL1 does not use them): they are disabled.
+  if(!c->running || !(read_pmovsclr_el0() & bit)){
+    write_pmintenclr_el1(~bit);
+    return;
+  }
+
+  record(core, f->elr);
+  arm_counter(c);
+  write_pmovsclr_el0(bit);
+  isb();
+}
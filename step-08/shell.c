@@ -49,15 +49,9 @@ void shell_main(){
       continue;
     }
 
-    // Find the relevant command in the list.
-    cmd_descr *d = cmds;
-    while(d->name != NULL){
-      if(strcmp(argv[0], d->name) == 0) break;
-      d++;
-    }
-
-    // Fail if no matching command found.
-    if(d->name == NULL){
+    // Find the relevant command in the list, and fail if there is none.
+    cmd_descr *d = cmd_find(argv[0]);
+    if(d == NULL){
       uart1_printf("Error: unknown command \"%s\".\n", argv[0]);
       uart1_printf("Use command \"help\" to get a list of commands.\n");
       continue;
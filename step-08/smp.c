@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <aarch64/cache.h>
+#include <aarch64/pmu.h>
+#include <aarch64/sysreg.h>
+#include <kernel/ipi.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include <kernel/timer.h>
+#include <kernel/twheel.h>
+
+// Entry point of the secondary cores (defined in "boot.S").
+extern char _start_secondary[];
+
+// The firmware keeps the secondary cores spinning (with their caches disabled)
+// on a "spin table": core i jumps to the address written at 0xd8 + 8 * i when
+// it becomes non-zero (and an event is signaled).
+#define SPIN_TABLE_BASE 0xd8ULL
+
+// Time (in ms) we are willing to wait for the secondary cores to come online.
+#define ONLINE_TIMEOUT_MS 100
+
+// States of a per-core work slot.
+#define SLOT_IDLE    0 // The core waits for work.
+#define SLOT_CLAIMED 1 // A caller is filling in the slot.
+#define SLOT_PENDING 2 // The core should run (or is running) the slot function.
+
+// Per-core work slot, on its own cache line to avoid false sharing.
+typedef struct {
+  volatile u64 state; // One of the SLOT_* constants.
+  smp_fn fn;          // Function to run.
+  void *arg;          // Argument to pass to the function.
+} __attribute__((aligned(CACHE_LINE_SIZE))) smp_slot;
+
+static smp_slot slots[NB_CORES];
+
+// Bit i is set if core i is online (the main core always is).
+static volatile u64 online_mask = 1;
+
+void smp_init(){
+  for(u64 core = 1; core < NB_CORES; core++){
+    volatile u64 *entry = (volatile u64 *) (SPIN_TABLE_BASE + 8 * core);
+    *entry = (u64) _start_secondary;
+    // The firmware reads the spin table with caches disabled.
+    dcache_clean_inval_range((void *) entry, sizeof(u64));
+  }
+  sev();
+
+  // Wait for all the secondary cores to be online (or for the timeout).
+  u64 all = (1ULL << NB_CORES) - 1;
+  u64 deadline = counter_ticks() + read_cntfrq_el0() * ONLINE_TIMEOUT_MS / 1000;
+  while(atomic_load_acquire(&online_mask) != all){
+    if(counter_ticks() > deadline) break;
+  }
+}
+
+void smp_secondary_entry(u64 core){
+  percpu_init_core();
+  irq_init();
+  ipi_init_core();
+  timer_init_core();
+  twheel_init_core();
+  pmu_enable();
+  atomic_fetch_add(&online_mask, 1ULL << core);
+
+  // Serve IPIs (an interrupt also wakes us up from "wfe").
+  irq_enable();
+
+  smp_slot *slot = &(slots[core]);
+  while(1){
+    if(atomic_load_acquire(&slot->state) != SLOT_PENDING){
+      wfe();
+      continue;
+    }
+
+    slot->fn(slot->arg);
+    atomic_store_release(&slot->state, SLOT_IDLE);
+    sev();
+  }
+}
+
+bool smp_is_online(u64 core){
+  if(core >= NB_CORES) return false;
+  return (atomic_load_acquire(&online_mask) >> core) & 1;
+}
+
+u64 smp_nb_online(){
+  u64 mask = atomic_load_acquire(&online_mask);
+  u64 nb = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    if((mask >> core) & 1) nb++;
+  }
+  return nb;
+}
+
+bool smp_run_on(u64 core, smp_fn fn, void *arg){
+  if(core == smp_core_id() || !smp_is_online(core)) return false;
+
+  smp_slot *slot = &(slots[core]);
+  if(!atomic_cas(&slot->state, SLOT_IDLE, SLOT_CLAIMED)) return false;
+
+  slot->fn  = fn;
+  slot->arg = arg;
+  atomic_store_release(&slot->state, SLOT_PENDING);
+  sev();
+
+  return true;
+}
+
+void smp_wait(u64 core){
+  if(core >= NB_CORES) return;
+
+  while(atomic_load_acquire(&(slots[core].state)) != SLOT_IDLE){
+    wfe();
+  }
+}
@@ -0,0 +1,257 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <aarch64/sysreg.h>
+#include <kernel/smp.h>
+#include <kernel/stage2.h>
+
+// We use 4KB granules and 32-bit IPAs, so that walks start at level 1 (with a
+// table of 4 entries, each covering 1GB). As for the stage-1 tables of EL1 (see
+// "mmu.c"), the first entry is a level-2 table with 2MB blocks (normal memory
+// below 0x3f000000, device memory above), and the second entry maps the ARM
+// local peripherals as a 1GB device memory block. Split blocks use level-3
+// tables (with 4KB pages), taken from a small pool.
+
+// Start of the BCM2837 peripherals in the physical address space.
+#define PERIPHERALS_BASE 0x3f000000ULL
+
+// Size of the regions covered by the entries of each level.
+#define L1_SIZE (1ULL << 30)
+#define L2_SIZE (1ULL << 21)
+#define L3_SIZE (1ULL << 12)
+
+// Fields of stage-2 descriptors.
+#define S2_DESC_VALID  0x1ULL
+#define S2_DESC_BLOCK  0x1ULL
+#define S2_DESC_TABLE  0x3ULL
+#define S2_DESC_PAGE   0x3ULL
+#define S2_DESC_TYPE   0x3ULL
+#define S2_MEM_DEVICE  (0x0ULL << 2)  // Device-nGnRnE.
+#define S2_MEM_NORMAL  (0xfULL << 2)  // Normal, inner/outer write-back.
+#define S2_AP(p)       (((u64) (p)) << 6)
+#define S2_AP_MASK     (3ULL << 6)
+#define S2_AP_READ     (1ULL << 6)
+#define S2_AP_WRITE    (1ULL << 7)
+#define S2_SH_INNER    (3ULL << 8)
+#define S2_AF          (1ULL << 10)
+#define S2_XN          (1ULL << 54)
+#define S2_ADDR_MASK   0xfffffffff000ULL
+
+// Translation control: T0SZ = 32 (32-bit IPAs), SL0 = 1 (start at level 1),
+// walks are inner/outer write-back cacheable and inner shareable, 4KB granule,
+// 32-bit physical addresses (PS = 0), and bit 31 is RES1.
+#define VTCR_VALUE (32ULL | (1ULL << 6) | (1ULL << 8) | (1ULL << 10) | \
+                    (3ULL << 12) | (1ULL << 31))
+
+// Bit of HCR_EL2 enabling stage-2 translation.
+#define HCR_VM (1ULL << 0)
+
+// Fault status codes (with the level in bits 1:0).
+#define DFSC_TRANSLATION 0x04
+#define DFSC_PERMISSION  0x0c
+#define DFSC_TYPE_MASK   0x3c
+
+// Number of level-3 tables (i.e., of 2MB blocks that can be split).
+#define NB_L3_TABLES 8
+
+// Tables, and the other state of the module (in the memory private to EL2,
+// which is zeroed by "boot.S").
+#define HYP __attribute__((aligned(4096), section(".hyp")))
+static u64 l1[512] HYP;
+static u64 l2[512] HYP;
+static u64 l3[NB_L3_TABLES][512] HYP;
+static u64 nb_l3 __attribute__((section(".hyp")));
+
+// Held while changing the tables (hypercalls may do it from any core).
+static volatile u64 lock __attribute__((section(".hyp")));
+
+// Memory private to EL2, and read-only part of the image (see "kernel8.ld").
+extern char __hyp_start[];
+extern char __hyp_end[];
+extern char __text_start[];
+extern char __rodata_end[];
+
+// Fault statistics of each core.
+typedef struct {
+  u64 nb_translation;
+  u64 nb_permission;
+  u64 nb_unemulated;
+  u64 last_fault;
+} __attribute__((aligned(64))) fault_stats;
+
+static fault_stats faults[NB_CORES] __attribute__((section(".hyp")));
+
+// Invalidate the TLB entries of EL1 (stage 1 and stage 2), on all cores.
+static void tlb_flush(){
+  asm volatile("dsb ish; tlbi vmalls12e1is; dsb ish; isb" : : : "memory");
+}
+
+// Split the 2MB block containing ipa into 4KB pages (with the same attributes)
+// if it is not already split, and return the level-3 table (or NULL).
+static u64 *split(u64 ipa){
+  u64 *d = &(l2[ipa / L2_SIZE]);
+  if((*d & S2_DESC_TYPE) == S2_DESC_TABLE){
+    return (u64 *) (*d & S2_ADDR_MASK);
+  }
+  if(nb_l3 == NB_L3_TABLES) return NULL;
+
+  // Pages of an unmapped block are unmapped (only the valid bit is cleared).
+  u64 *t = l3[nb_l3++];
+  u64 base = *d & S2_ADDR_MASK;
+  u64 attrs = *d & ~(S2_ADDR_MASK | S2_DESC_TYPE);
+  u64 type = *d & S2_DESC_VALID ? S2_DESC_PAGE : S2_DESC_PAGE & ~S2_DESC_VALID;
+  for(u64 i = 0; i < 512; i++){
+    t[i] = (base + i * L3_SIZE) | attrs | type;
+  }
+
+  // Break-before-make: the block is invalidated (and removed from the TLBs)
+  // before the table replaces it.
+  *d = 0;
+  tlb_flush();
+  *d = (u64) t | S2_DESC_TABLE;
+  tlb_flush();
+  return t;
+}
+
+// Descriptor d of the given type, with permissions perm. Unmapped descriptors
+// keep their fields (only the valid bit is cleared).
+static u64 with_perm(u64 d, u64 type, u64 perm){
+  u64 v = (d & ~(S2_AP_MASK | S2_DESC_TYPE)) | S2_AP(perm) | type;
+  if(perm == S2_NONE) v &= ~S2_DESC_VALID;
+  return v;
+}
+
+static bool protect(u64 ipa, u64 size, u64 perm){
+  u64 start = ipa & ~(L3_SIZE - 1);
+  u64 end = ipa + size;
+  if(end > L1_SIZE) return false;
+
+  u64 page = start;
+  while(page < end){
+    // Whole 2MB blocks are changed directly (unless they are already split).
+    u64 *b = &(l2[page / L2_SIZE]);
+    if(page % L2_SIZE == 0 && end - page >= L2_SIZE &&
+       (*b & S2_DESC_TYPE) != S2_DESC_TABLE){
+      *b = with_perm(*b, S2_DESC_BLOCK, perm);
+      page += L2_SIZE;
+      continue;
+    }
+
+    u64 *t = split(page);
+    if(t == NULL) return false;
+    u64 *d = &(t[(page % L2_SIZE) / L3_SIZE]);
+    *d = with_perm(*d, S2_DESC_PAGE, perm);
+    page += L3_SIZE;
+  }
+
+  tlb_flush();
+  return true;
+}
+
+bool stage2_protect(u64 ipa, u64 size, u64 perm){
+  while(!atomic_cas(&lock, 0, 1)){
+    // Spin.
+  }
+  bool ok = protect(ipa, size, perm);
+  atomic_store_release(&lock, 0);
+  return ok;
+}
+
+void stage2_init(){
+  u64 normal = S2_DESC_BLOCK | S2_MEM_NORMAL | S2_AP(S2_RW) | S2_SH_INNER |
+               S2_AF;
+  u64 device = S2_DESC_BLOCK | S2_MEM_DEVICE | S2_AP(S2_RW) | S2_AF | S2_XN;
+
+  for(u64 i = 0; i < 512; i++){
+    u64 addr = i * L2_SIZE;
+    l2[i] = addr | (addr < PERIPHERALS_BASE ? normal : device);
+    l1[i] = 0;
+  }
+  l1[0] = (u64) l2 | S2_DESC_TABLE;
+  l1[1] = L1_SIZE | device;
+
+  // Hide the memory private to EL2, and protect the code and read-only data
+  // (of EL2 in particular).
+  stage2_protect((u64) __hyp_start, (u64) (__hyp_end - __hyp_start), S2_NONE);
+  stage2_protect((u64) __text_start, (u64) (__rodata_end - __text_start),
+                 S2_RO);
+
+  stage2_enable();
+}
+
+void stage2_enable(){
+  write_vtcr_el2(VTCR_VALUE);
+  write_vttbr_el2((u64) l1);
+  isb();
+  write_hcr_el2(read_hcr_el2() | HCR_VM);
+  isb();
+  tlb_flush();
+}
+
+u64 stage2_fault_ipa(){
+  return ((read_hpfar_el2() >> 4) << 12) | (read_far_el2() & 0xfff);
+}
+
+// Indicates whether the current descriptor of the page containing ipa allows
+// the access (a write if write is set). The lock is taken so that a descriptor
+// being replaced (see split()) is not mistaken for an unmapped one.
+static bool allowed(u64 ipa, bool write){
+  if(ipa >= L1_SIZE) return true;
+  while(!atomic_cas(&lock, 0, 1)){
+    // Spin.
+  }
+  u64 d = l2[ipa / L2_SIZE];
+  if((d & S2_DESC_TYPE) == S2_DESC_TABLE){
+    d = ((u64 *) (d & S2_ADDR_MASK))[(ipa % L2_SIZE) / L3_SIZE];
+  }
+  atomic_store_release(&lock, 0);
+  return (d & S2_DESC_VALID) && (d & (write ? S2_AP_WRITE : S2_AP_READ));
+}
+
+bool stage2_data_abort(hvc_frame *f, u64 esr){
+  u64 type = ISS_DFSC(esr) & DFSC_TYPE_MASK;
+  if(type != DFSC_TRANSLATION && type != DFSC_PERMISSION) return false;
+
+  // The mappings may have changed (on another core) since the access trapped,
+  // e.g., when MMIO tracing stops: the access is then performed again.
+  u64 ipa = stage2_fault_ipa();
+  if(allowed(ipa, (esr & ISS_WNR) && !(esr & ISS_CM))) return true;
+
+  fault_stats *s = &(faults[smp_core_id()]);
+  s->last_fault = ipa;
+  if(type == DFSC_TRANSLATION){
+    s->nb_translation++;
+  } else {
+    s->nb_permission++;
+  }
+
+  // Loads return 0, and stores (and cache maintenance) are ignored. Without a
+  // valid syndrome, the instruction is skipped without emulation.
+  if(esr & ISS_CM){
+    // Nothing to do.
+  } else if(esr & ISS_ISV){
+    u64 rt = ISS_SRT(esr);
+    if(!(esr & ISS_WNR) && rt != 31) f->x[rt] = 0;
+  } else {
+    s->nb_unemulated++;
+  }
+  f->elr += 4;
+  return true;
+}
+
+void stage2_get_stats(stage2_stats *s){
+  s->nb_translation = 0;
+  s->nb_permission = 0;
+  s->nb_unemulated = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    s->nb_translation += faults[core].nb_translation;
+    s->nb_permission += faults[core].nb_permission;
+    s->nb_unemulated += faults[core].nb_unemulated;
+  }
+  s->nb_split = nb_l3;
+}
+
+u64 stage2_last_fault(){
+  return faults[smp_core_id()].last_fault;
+}
@@ -82,3 +82,24 @@ int strcmp(const char *s1, const char *s2){
 
   return 1;
 }
+
+void *memcpy(void *dest, const void *src, size_t n){
+  unsigned char *d = dest;
+  const unsigned char *s = src;
+
+  while(n--){
+    *d++ = *s++;
+  }
+
+  return dest;
+}
+
+void *memset(void *s, int c, size_t n){
+  unsigned char *p = s;
+
+  while(n--){
+    *p++ = (unsigned char) c;
+  }
+
+  return s;
+}
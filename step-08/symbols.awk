@@ -0,0 +1,26 @@
+# Generate the table of functions of "include/kernel/symbols.h" (an assembly
+# file) from the output of "nm -n" on the kernel, keeping the code symbols only.
+# Symbols at the same address as the previous one are skipped.
+
+BEGIN { n = 0 }
+
+$2 ~ /^[tT]$/ && $3 !~ /^\$/ {
+  addr = "0x" $1
+  if(n > 0 && addr == addrs[n - 1]) next
+  addrs[n] = addr
+  names[n] = $3
+  n++
+}
+
+END {
+  print "// Generated by \"symbols.awk\" (see \"include/kernel/symbols.h\")."
+  print ".section \".rodata\""
+  print ".balign 8"
+  print ".globl kernel_nb_symbols"
+  print "kernel_nb_symbols:"
+  printf "  .quad %d\n", n
+  print ".globl kernel_symbols"
+  print "kernel_symbols:"
+  for(i = 0; i < n; i++) printf "  .quad %s, .Lname%d\n", addrs[i], i
+  for(i = 0; i < n; i++) printf ".Lname%d: .asciz \"%s\"\n", i, names[i]
+}
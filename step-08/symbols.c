@@ -0,0 +1,26 @@
+#include <stddef.h>
+#include <types.h>
+#include <kernel/symbols.h>
+
+// End of the code (defined in "kernel8.ld").
+extern char __text_end[];
+
+const symbol *symbol_lookup(u64 addr){
+  u64 n = kernel_nb_symbols;
+  if(n == 0 || addr < kernel_symbols[0].addr || addr >= (u64) __text_end){
+    return NULL;
+  }
+
+  // Binary search of the last symbol starting at or below addr.
+  u64 lo = 0;
+  u64 hi = n;
+  while(hi - lo > 1){
+    u64 mid = lo + (hi - lo) / 2;
+    if(kernel_symbols[mid].addr <= addr){
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return &(kernel_symbols[lo]);
+}
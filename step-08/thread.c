@@ -0,0 +1,428 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <aarch64/cache.h>
+#include <aarch64/sysreg.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+
+// Save the current context to "from", and resume the context in "to".
+// (Defined in "switch.S".)
+void context_switch(thread_context *from, thread_context *to);
+
+// Default length of a time slice (in microseconds).
+#define DEFAULT_SLICE_US 10000
+
+// Per-core scheduler state (threads never migrate, so no locking is needed,
+// but IRQs must be masked while the state is modified, since the scheduler is
+// also invoked from the timer interrupt handler).
+typedef struct {
+  bool started;                    // Has "sched_start" been called?
+  thread idle;                     // Idle thread (initial flow of control).
+  thread *current;                 // Currently running thread.
+  thread *rq_head[NB_PRIORITIES];  // First thread of each run queue.
+  thread *rq_tail[NB_PRIORITIES];  // Last thread of each run queue.
+  u64 rq_mask;                     // Bit p set if run queue p is non-empty.
+  thread *sleepers;                // Sleeping threads (unordered).
+  thread *zombie;                  // Thread that exited, to free after a switch.
+  bool need_resched;               // Preemption requested by an IRQ handler.
+  u64 last_switch;                 // Time of the last switch (in timer ticks).
+} __attribute__((aligned(CACHE_LINE_SIZE))) sched_core;
+
+static DEFINE_PER_CPU(sched_core, sched_core_data);
+
+// Thread descriptors and their stacks.
+static thread threads[MAX_THREADS];
+static u8 stacks[MAX_THREADS][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+// Next thread identifier (0 is used by idle threads).
+static volatile u64 next_id = 1;
+
+// Timer configuration (shared by all cores).
+static u64 timer_mode = SCHED_PERIODIC;
+static u64 slice_us = DEFAULT_SLICE_US;
+
+static sched_core *this_core(){
+  return this_cpu_ptr(sched_core_data);
+}
+
+static bool is_idle(sched_core *sc, thread *t){
+  return t == &(sc->idle);
+}
+
+// Indicates whether the current thread can block (IRQs masked means that we
+// are in an interrupt handler, or in a critical section).
+static bool can_block(sched_core *sc){
+  return sc->started && !is_idle(sc, sc->current) && !irq_masked();
+}
+
+static void rq_push(sched_core *sc, thread *t){
+  u64 p = t->prio;
+
+  t->state = THREAD_READY;
+  t->next = NULL;
+  if(sc->rq_tail[p]){
+    sc->rq_tail[p]->next = t;
+  } else {
+    sc->rq_head[p] = t;
+  }
+  sc->rq_tail[p] = t;
+  sc->rq_mask |= 1ULL << p;
+}
+
+// Highest priority of a ready thread (or -1 if there are none).
+static i64 rq_highest(sched_core *sc){
+  if(sc->rq_mask == 0) return -1;
+  return 63 - __builtin_clzll(sc->rq_mask);
+}
+
+// Remove and return the first thread of highest priority (or NULL).
+static thread *rq_pop(sched_core *sc){
+  i64 p = rq_highest(sc);
+  if(p < 0) return NULL;
+
+  thread *t = sc->rq_head[p];
+  sc->rq_head[p] = t->next;
+  if(sc->rq_head[p] == NULL){
+    sc->rq_tail[p] = NULL;
+    sc->rq_mask &= ~(1ULL << p);
+  }
+  t->next = NULL;
+  return t;
+}
+
+// Move the sleeping threads whose deadline has passed to the run queues.
+static void wake_sleepers(sched_core *sc){
+  u64 now = counter_ticks();
+  thread **prev = &(sc->sleepers);
+
+  while(*prev){
+    thread *t = *prev;
+    if(t->wake_time <= now){
+      *prev = t->next;
+      rq_push(sc, t);
+    } else {
+      prev = &(t->next);
+    }
+  }
+}
+
+// Charge the time since the last switch to the current thread.
+static void account(sched_core *sc){
+  u64 now = counter_ticks();
+  sc->current->runtime += now - sc->last_switch;
+  sc->last_switch = now;
+}
+
+// Program the timer of the core, assuming that thread t is about to run.
+static void program_timer(sched_core *sc, thread *t){
+  u64 slice = timer_us_to_ticks(slice_us);
+
+  if(timer_mode == SCHED_PERIODIC){
+    timer_set_oneshot(TIMER_SCHED, slice);
+    return;
+  }
+
+  // Tickless: only end the time slice if a thread of the same priority (or of
+  // a higher one) is ready, or if a sleeping thread needs to be woken up.
+  u64 now = counter_ticks();
+  u64 deadline = UINT64_MAX;
+  if(!is_idle(sc, t) && rq_highest(sc) >= (i64) t->prio){
+    deadline = now + slice;
+  }
+  for(thread *s = sc->sleepers; s; s = s->next){
+    if(s->wake_time < deadline) deadline = s->wake_time;
+  }
+
+  if(deadline == UINT64_MAX){
+    timer_disable(TIMER_SCHED);
+  } else {
+    timer_set_deadline(TIMER_SCHED, deadline);
+  }
+}
+
+// Code run right after switching to a thread.
+static void finish_switch(sched_core *sc){
+  // We are no longer running on the stack of the exited thread (if any).
+  if(sc->zombie){
+    atomic_store_release((volatile u64 *) &(sc->zombie->state), THREAD_FREE);
+    sc->zombie = NULL;
+  }
+}
+
+// Switch to the ready thread with the highest priority (or to the idle thread
+// if there is none). The current thread must have been put in the appropriate
+// queue (if any) by the caller, and IRQs must be masked.
+static void schedule(sched_core *sc){
+  thread *prev = sc->current;
+
+  wake_sleepers(sc);
+  thread *next = rq_pop(sc);
+  if(next == NULL) next = &(sc->idle);
+
+  program_timer(sc, next);
+  next->state = THREAD_RUNNING;
+  if(next == prev) return;
+
+  account(sc);
+  next->nb_switches++;
+  sc->current = next;
+  context_switch(&(prev->ctx), &(next->ctx));
+  finish_switch(sc);
+}
+
+// Put the current thread back in its run queue, and switch to the ready thread
+// with the highest priority (IRQs must be masked). In an IRQ handler, this is
+// deferred to "sched_irq_exit", when the handler is done.
+static void preempt(sched_core *sc){
+  if(irq_in_handler()){
+    sc->need_resched = true;
+    return;
+  }
+
+  thread *cur = sc->current;
+  if(!is_idle(sc, cur)){
+    cur->nb_preempted++;
+    rq_push(sc, cur);
+  }
+  schedule(sc);
+}
+
+// Preempt the current thread if a thread of higher priority is ready (IRQs
+// must be masked).
+static void check_preempt(sched_core *sc){
+  thread *cur = sc->current;
+  i64 best = rq_highest(sc);
+
+  if(is_idle(sc, cur) ? best >= 0 : best > (i64) cur->prio){
+    preempt(sc);
+  } else {
+    // A time slice may now be needed (tickless mode).
+    program_timer(sc, cur);
+  }
+}
+
+// Entry point of all threads (see "thread_create").
+static void thread_entry(){
+  sched_core *sc = this_core();
+  finish_switch(sc);
+
+  // We may have been switched to from an interrupt handler.
+  irq_enable();
+
+  thread *t = sc->current;
+  t->fn(t->arg);
+  thread_exit();
+}
+
+thread *thread_create(const char *name, u64 prio, thread_fn fn, void *arg){
+  sched_core *sc = this_core();
+  if(prio >= NB_PRIORITIES) prio = NB_PRIORITIES - 1;
+
+  for(u64 i = 0; i < MAX_THREADS; i++){
+    thread *t = &(threads[i]);
+    volatile u64 *state = (volatile u64 *) &(t->state);
+    if(!atomic_cas(state, THREAD_FREE, THREAD_READY)) continue;
+
+    t->id           = atomic_fetch_add(&next_id, 1);
+    t->name         = name;
+    t->prio         = prio;
+    t->core         = smp_core_id();
+    t->wake_time    = 0;
+    t->fn           = fn;
+    t->arg          = arg;
+    t->nb_switches  = 0;
+    t->nb_preempted = 0;
+    t->runtime      = 0;
+
+    // Initial context: we "return" to "thread_entry" on the new stack.
+    for(u64 r = 0; r < 10; r++){
+      t->ctx.x19_x28[r] = 0;
+    }
+    t->ctx.fp = 0;
+    t->ctx.lr = (u64) thread_entry;
+    t->ctx.sp = (u64) &(stacks[i][THREAD_STACK_SIZE]);
+
+    u64 flags = irq_save();
+    rq_push(sc, t);
+    if(sc->started) check_preempt(sc);
+    irq_restore(flags);
+
+    return t;
+  }
+
+  return NULL;
+}
+
+void sched_start(){
+  sched_core *sc = this_core();
+
+  irq_disable();
+  sc->idle.id    = 0;
+  sc->idle.name  = "idle";
+  sc->idle.prio  = 0;
+  sc->idle.state = THREAD_RUNNING;
+  sc->idle.core  = smp_core_id();
+  sc->current    = &(sc->idle);
+  sc->last_switch = counter_ticks();
+  sc->started    = true;
+
+  program_timer(sc, sc->current);
+  irq_enable();
+
+  // Threads made ready by interrupt handlers preempt the idle thread, so it
+  // is safe to wait for interrupts here.
+  while(1){
+    thread_yield();
+    asm volatile("wfi");
+  }
+}
+
+void sched_configure(u64 mode, u64 slice){
+  timer_mode = mode == SCHED_TICKLESS ? SCHED_TICKLESS : SCHED_PERIODIC;
+  slice_us = slice ? slice : DEFAULT_SLICE_US;
+}
+
+u64 sched_mode(){
+  return timer_mode;
+}
+
+u64 sched_slice_us(){
+  return slice_us;
+}
+
+void sched_timer_tick(){
+  sched_core *sc = this_core();
+  if(!sc->started){
+    timer_disable(TIMER_SCHED);
+    return;
+  }
+
+  account(sc);
+  wake_sleepers(sc);
+
+  // End of the time slice: threads of the same priority get to run.
+  thread *cur = sc->current;
+  i64 best = rq_highest(sc);
+  if(is_idle(sc, cur) ? best >= 0 : best >= (i64) cur->prio){
+    preempt(sc);
+  } else {
+    program_timer(sc, cur);
+  }
+}
+
+void sched_irq_exit(){
+  sched_core *sc = this_core();
+  if(!sc->started || !sc->need_resched) return;
+
+  sc->need_resched = false;
+  preempt(sc);
+}
+
+thread *thread_current(){
+  sched_core *sc = this_core();
+  return sc->started ? sc->current : NULL;
+}
+
+void thread_yield(){
+  sched_core *sc = this_core();
+  if(!sc->started || irq_masked()) return;
+
+  u64 flags = irq_save();
+  if(!is_idle(sc, sc->current)) rq_push(sc, sc->current);
+  schedule(sc);
+  irq_restore(flags);
+}
+
+void thread_sleep_us(u64 us){
+  sched_core *sc = this_core();
+  u64 deadline = counter_ticks() + timer_us_to_ticks(us);
+
+  // If we cannot block, we can only busy-wait.
+  if(!can_block(sc)){
+    while(counter_ticks() < deadline);
+    return;
+  }
+
+  u64 flags = irq_save();
+  thread *t = sc->current;
+  t->state = THREAD_SLEEPING;
+  t->wake_time = deadline;
+  t->next = sc->sleepers;
+  sc->sleepers = t;
+  schedule(sc);
+  irq_restore(flags);
+}
+
+void thread_exit(){
+  sched_core *sc = this_core();
+
+  irq_disable();
+  sc->current->state = THREAD_DEAD;
+  sc->zombie = sc->current;
+  schedule(sc);
+
+  while(1); // Not reachable.
+}
+
+void event_init(event *ev){
+  ev->waiters = NULL;
+  ev->seq = 0;
+}
+
+void event_wait(event *ev){
+  event_wait_seq(ev, ev->seq);
+}
+
+void event_wait_seq(event *ev, u64 seq){
+  sched_core *sc = this_core();
+
+  // If we cannot block, we simply give other threads a chance to run.
+  if(!can_block(sc)){
+    thread_yield();
+    return;
+  }
+
+  u64 flags = irq_save();
+  if(ev->seq == seq){
+    thread *t = sc->current;
+    t->state = THREAD_WAITING;
+    t->next = ev->waiters;
+    ev->waiters = t;
+    schedule(sc);
+  }
+  irq_restore(flags);
+}
+
+void event_signal(event *ev){
+  sched_core *sc = this_core();
+
+  u64 flags = irq_save();
+  ev->seq++;
+  while(ev->waiters){
+    thread *t = ev->waiters;
+    ev->waiters = t->next;
+    rq_push(sc, t);
+  }
+  if(sc->started) check_preempt(sc);
+  irq_restore(flags);
+}
+
+u64 thread_list(thread **ts, u64 max){
+  u64 nb = 0;
+
+  for(u64 core = 0; core < NB_CORES && nb < max; core++){
+    sched_core *sc = per_cpu_ptr(sched_core_data, core);
+    if(sc->started) ts[nb++] = &(sc->idle);
+  }
+
+  for(u64 i = 0; i < MAX_THREADS && nb < max; i++){
+    if(threads[i].state != THREAD_FREE) ts[nb++] = &(threads[i]);
+  }
+
+  return nb;
+}
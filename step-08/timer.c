@@ -0,0 +1,106 @@
+#include <stddef.h>
+#include <macros.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <bcm2837/local.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/twheel.h>
+
+// Bits of the CNTP_CTL_EL0 register.
+#define CNTP_CTL_ENABLE  (1ULL << 0)
+#define CNTP_CTL_IMASK   (1ULL << 1)
+#define CNTP_CTL_ISTATUS (1ULL << 2)
+
+// Deadlines of the clients on the core (absolute counter values, with 0 used
+// for "no deadline", since the counter is never 0 when we run).
+typedef struct {
+  u64 deadlines[NB_TIMER_CLIENTS];
+} timer_core;
+
+static DEFINE_PER_CPU(timer_core, timer_core_data);
+
+// Handlers of the clients.
+static void (*client_handlers[NB_TIMER_CLIENTS])() = {
+  [TIMER_SCHED] = sched_timer_tick,
+  [TIMER_WHEEL] = twheel_expire
+};
+
+// Program the timer for the earliest deadline (IRQs must be masked).
+static void reprogram(timer_core *tc){
+  u64 next = 0;
+  for(u64 c = 0; c < NB_TIMER_CLIENTS; c++){
+    u64 d = tc->deadlines[c];
+    if(d != 0 && (next == 0 || d < next)) next = d;
+  }
+
+  if(next == 0){
+    write_cntp_ctl_el0(0);
+  } else {
+    write_cntp_cval_el0(next);
+    write_cntp_ctl_el0(CNTP_CTL_ENABLE);
+  }
+}
+
+// Handler for the timer interrupt. The latency is the time since the deadline.
+static void timer_irq(void *arg){
+  UNUSED(arg);
+  irq_record_latency(IRQ_CNTPNS, irq_entry_ticks() - read_cntp_cval_el0());
+
+  timer_core *tc = this_cpu_ptr(timer_core_data);
+  u64 now = counter_ticks();
+  for(u64 c = 0; c < NB_TIMER_CLIENTS; c++){
+    u64 d = tc->deadlines[c];
+    if(d == 0 || d > now) continue;
+
+    // The handler may set a new deadline.
+    tc->deadlines[c] = 0;
+    client_handlers[c]();
+  }
+
+  reprogram(tc);
+}
+
+void timer_init_core(){
+  timer_core *tc = this_cpu_ptr(timer_core_data);
+  for(u64 c = 0; c < NB_TIMER_CLIENTS; c++){
+    tc->deadlines[c] = 0;
+  }
+  write_cntp_ctl_el0(0);
+
+  irq_register(IRQ_CNTPNS, "timer", timer_irq, NULL);
+  *LOCAL_TIMER_IRQ_CNTL(smp_core_id()) |= LOCAL_TIMER_CNTPNS_IRQ;
+}
+
+void timer_set_deadline(u64 client, u64 deadline){
+  if(deadline == 0) deadline = 1;
+
+  u64 flags = irq_save();
+  timer_core *tc = this_cpu_ptr(timer_core_data);
+  tc->deadlines[client] = deadline;
+  reprogram(tc);
+  irq_restore(flags);
+}
+
+void timer_set_oneshot(u64 client, u64 ticks){
+  timer_set_deadline(client, counter_ticks() + ticks);
+}
+
+void timer_disable(u64 client){
+  u64 flags = irq_save();
+  timer_core *tc = this_cpu_ptr(timer_core_data);
+  tc->deadlines[client] = 0;
+  reprogram(tc);
+  irq_restore(flags);
+}
+
+u64 timer_us_to_ticks(u64 us){
+  return us * read_cntfrq_el0() / 1000000;
+}
+
+u64 timer_ticks_to_us(u64 ticks){
+  return ticks * 1000000 / read_cntfrq_el0();
+}
@@ -0,0 +1,291 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/sysreg.h>
+#include <kernel/irq.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include <kernel/timer.h>
+#include <kernel/twheel.h>
+
+// Per-core timer wheel.
+typedef struct {
+  bool initialised;
+  bool expiring;                              // Running callbacks?
+  u64 now;                                    // Next wheel tick to process.
+  u64 tick_len;                               // Wheel tick (in timer ticks).
+  u64 bitmap[TWHEEL_LEVELS];                  // Non-empty slots.
+  wtimer *slots[TWHEEL_LEVELS][TWHEEL_SLOTS]; // Lists of timers.
+  twheel_stats stats;
+} twheel;
+
+static DEFINE_PER_CPU(twheel, twheel_data);
+
+// Rotate the bits of x right by n positions (n from 0 to 63).
+static u64 ror64(u64 x, u64 n){
+  return n == 0 ? x : (x >> n) | (x << (64 - n));
+}
+
+static u64 current_tick(twheel *w){
+  return counter_ticks() / w->tick_len;
+}
+
+// Insert the timer in the slot corresponding to its expiry tick.
+static void slot_insert(twheel *w, wtimer *t){
+  u64 expires = t->expires < w->now ? w->now : t->expires;
+  u64 delta = expires - w->now;
+
+  u64 l = 0;
+  while(l < TWHEEL_LEVELS && (delta >> (TWHEEL_SLOT_BITS * (l + 1))) != 0){
+    l++;
+  }
+  if(l == TWHEEL_LEVELS){
+    // Beyond the range of the wheel: park the timer in the last slot of the
+    // last level (it will be re-inserted when that slot is cascaded).
+    l = TWHEEL_LEVELS - 1;
+    expires = w->now + (1ULL << (TWHEEL_SLOT_BITS * TWHEEL_LEVELS)) - 1;
+  }
+
+  u64 slot = (expires >> (TWHEEL_SLOT_BITS * l)) & (TWHEEL_SLOTS - 1);
+  t->level = l;
+  t->slot = slot;
+  t->prev = NULL;
+  t->next = w->slots[l][slot];
+  if(t->next) t->next->prev = t;
+  w->slots[l][slot] = t;
+  w->bitmap[l] |= 1ULL << slot;
+}
+
+static void slot_remove(twheel *w, wtimer *t){
+  if(t->prev){
+    t->prev->next = t->next;
+  } else {
+    w->slots[t->level][t->slot] = t->next;
+  }
+  if(t->next) t->next->prev = t->prev;
+  if(w->slots[t->level][t->slot] == NULL){
+    w->bitmap[t->level] &= ~(1ULL << t->slot);
+  }
+  t->next = NULL;
+  t->prev = NULL;
+}
+
+// Detach (and return) the list of timers of a slot.
+static wtimer *slot_take(twheel *w, u64 l, u64 slot){
+  wtimer *list = w->slots[l][slot];
+  w->slots[l][slot] = NULL;
+  w->bitmap[l] &= ~(1ULL << slot);
+  return list;
+}
+
+// Next wheel tick (at least w->now) at which a slot of level 0 expires, or a
+// slot of a higher level must be cascaded (UINT64_MAX if there is none).
+static u64 next_event(twheel *w){
+  u64 best = UINT64_MAX;
+
+  // Level 0: the slot of tick w->now is the first one to consider.
+  if(w->bitmap[0]){
+    u64 idx = w->now & (TWHEEL_SLOTS - 1);
+    best = w->now + __builtin_ctzll(ror64(w->bitmap[0], idx));
+  }
+
+  // Higher levels: the slot containing the last processed tick has already
+  // been cascaded (its timers are for the next round).
+  u64 last = w->now - 1;
+  for(u64 l = 1; l < TWHEEL_LEVELS; l++){
+    if(!w->bitmap[l]) continue;
+    u64 shift = TWHEEL_SLOT_BITS * l;
+    u64 base = last >> shift;
+    u64 idx = base & (TWHEEL_SLOTS - 1);
+    u64 rot = (idx + 1) & (TWHEEL_SLOTS - 1);
+    u64 dist = __builtin_ctzll(ror64(w->bitmap[l], rot)) + 1;
+    u64 time = (base + dist) << shift;
+    if(time < best) best = time;
+  }
+
+  return best;
+}
+
+// Program the timer for the next event of the wheel (IRQs must be masked).
+static void program(twheel *w){
+  if(w->stats.nb_pending == 0){
+    timer_disable(TIMER_WHEEL);
+  } else {
+    timer_set_deadline(TIMER_WHEEL, next_event(w) * w->tick_len);
+  }
+}
+
+// Move the timers of the higher-level slots that start at tick w->now (which
+// is a multiple of TWHEEL_SLOTS) to lower levels.
+static void cascade(twheel *w){
+  for(u64 l = 1; l < TWHEEL_LEVELS; l++){
+    u64 idx = (w->now >> (TWHEEL_SLOT_BITS * l)) & (TWHEEL_SLOTS - 1);
+    wtimer *t = slot_take(w, l, idx);
+    while(t){
+      wtimer *next = t->next;
+      slot_insert(w, t);
+      w->stats.nb_cascaded++;
+      t = next;
+    }
+    if(idx != 0) break;
+  }
+}
+
+// Log2 bucket of a lateness (in microseconds).
+static u64 hist_bucket(u64 us){
+  if(us == 0) return 0;
+  u64 b = 64 - __builtin_clzll(us);
+  return b < TWHEEL_HIST_SIZE ? b : TWHEEL_HIST_SIZE - 1;
+}
+
+// Run all the timers of the level 0 slot of tick w->now (as a batch).
+static void run_slot(twheel *w){
+  wtimer *t = slot_take(w, 0, w->now & (TWHEEL_SLOTS - 1));
+  if(t == NULL) return;
+
+  u64 nb = 0;
+  while(t){
+    wtimer *next = t->next;
+    t->next = NULL;
+    t->pending = false;
+    w->stats.nb_pending--;
+
+    u64 now = counter_ticks();
+    u64 late = now > t->deadline ? timer_ticks_to_us(now - t->deadline) : 0;
+    w->stats.hist[hist_bucket(late)]++;
+    w->stats.nb_expired++;
+    nb++;
+
+    t->fn(t->arg);
+    t = next;
+  }
+
+  w->stats.nb_batches++;
+  if(nb > w->stats.max_batch) w->stats.max_batch = nb;
+}
+
+void twheel_init_core(){
+  twheel *w = this_cpu_ptr(twheel_data);
+  w->tick_len = timer_us_to_ticks(TWHEEL_TICK_US);
+  if(w->tick_len == 0) w->tick_len = 1;
+  w->now = current_tick(w);
+  if(w->now == 0) w->now = 1;
+  w->initialised = true;
+}
+
+void twheel_expire(){
+  twheel *w = this_cpu_ptr(twheel_data);
+  if(!w->initialised) return;
+
+  u64 cur = current_tick(w);
+  w->expiring = true;
+  while(w->now <= cur){
+    if((w->now & (TWHEEL_SLOTS - 1)) == 0) cascade(w);
+    run_slot(w);
+    w->now++;
+
+    // Skip the ticks without anything to do.
+    u64 next = next_event(w);
+    if(next > w->now) w->now = next < cur + 1 ? next : cur + 1;
+  }
+  w->expiring = false;
+
+  program(w);
+}
+
+void wtimer_init(wtimer *t, wtimer_fn fn, void *arg){
+  t->next = NULL;
+  t->prev = NULL;
+  t->pending = false;
+  t->fn = fn;
+  t->arg = arg;
+}
+
+void wtimer_arm(wtimer *t, u64 us){
+  twheel *w = this_cpu_ptr(twheel_data);
+  u64 flags = irq_save();
+
+  if(t->pending){
+    slot_remove(w, t);
+    w->stats.nb_pending--;
+  }
+
+  // Nothing to process: the wheel can jump to the current tick.
+  if(w->stats.nb_pending == 0 && !w->expiring){
+    u64 cur = current_tick(w);
+    if(cur > w->now) w->now = cur;
+  }
+
+  // Round up to the next wheel tick (callbacks never run early). While the
+  // wheel runs callbacks, the slot of tick w->now has already been taken.
+  t->deadline = counter_ticks() + timer_us_to_ticks(us);
+  t->expires = (t->deadline + w->tick_len - 1) / w->tick_len;
+  if(w->expiring && t->expires <= w->now) t->expires = w->now + 1;
+  t->core = smp_core_id();
+  t->pending = true;
+  slot_insert(w, t);
+  w->stats.nb_pending++;
+  w->stats.nb_armed++;
+
+  // The timer is reprogrammed by "twheel_expire" when it is running.
+  if(!w->expiring) program(w);
+  irq_restore(flags);
+}
+
+bool wtimer_cancel(wtimer *t){
+  twheel *w = this_cpu_ptr(twheel_data);
+  u64 flags = irq_save();
+
+  bool pending = t->pending;
+  if(pending){
+    slot_remove(w, t);
+    t->pending = false;
+    w->stats.nb_pending--;
+    w->stats.nb_cancelled++;
+    // An early wake-up is harmless, we only stop the timer when possible.
+    if(w->stats.nb_pending == 0 && !w->expiring) timer_disable(TIMER_WHEEL);
+  }
+
+  irq_restore(flags);
+  return pending;
+}
+
+bool wtimer_pending(wtimer *t){
+  return t->pending;
+}
+
+void twheel_get_stats(u64 core, twheel_stats *s){
+  *s = per_cpu_ptr(twheel_data, core)->stats;
+}
+
+void twheel_reset_stats(){
+  for(u64 core = 0; core < NB_CORES; core++){
+    twheel_stats *s = &(per_cpu_ptr(twheel_data, core)->stats);
+    s->nb_armed = 0;
+    s->nb_cancelled = 0;
+    s->nb_expired = 0;
+    s->nb_batches = 0;
+    s->max_batch = 0;
+    s->nb_cascaded = 0;
+    for(u64 i = 0; i < TWHEEL_HIST_SIZE; i++){
+      s->hist[i] = 0;
+    }
+  }
+}
+
+u64 twheel_pending(wtimer **ts, u64 max){
+  twheel *w = this_cpu_ptr(twheel_data);
+  u64 nb = 0;
+
+  u64 flags = irq_save();
+  for(u64 l = 0; l < TWHEEL_LEVELS; l++){
+    for(u64 s = 0; s < TWHEEL_SLOTS; s++){
+      for(wtimer *t = w->slots[l][s]; t && nb < max; t = t->next){
+        ts[nb++] = t;
+      }
+    }
+  }
+  irq_restore(flags);
+
+  return nb;
+}
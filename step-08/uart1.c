@@ -1,36 +1,21 @@
 #include <stdarg.h>
+#include <stdbool.h>
 #include <macros.h>
 #include <bits.h>
 #include <types.h>
 #include <bcm2837/auxiliaries.h>
 #include <bcm2837/gpio.h>
 #include <bcm2837/uart1.h>
-
-// Wait for at least n CPU cycles.
-void wait_cycles(u32 n){
-  while(n--){
-    asm volatile("nop");
-  }
-}
+#include <kernel/console.h>
+#include <kernel/smp.h>
+#include <kernel/thread.h>
 
 void uart1_init(){
-  // We first need to map UART1 to the GPIO pins.
-  // We need to set the function of pins 14 and 15 to alternative 5.
-  // (Both are configured via alternate function select register 0: GPFSEL1.)
-  u32 r = *GPFSEL1;       // Get the current value of the register.
-  r &= ~MASK_U32(12, 3);  // Clear the config for pin 14.
-  r &= ~MASK_U32(15, 3);  // Clear the config for pin 15.
-  r |= GPFSEL_ALT5 << 12; // Select alternative function 5 for pin 14.
-  r |= GPFSEL_ALT5 << 15; // Select alternative function 5 for pin 15.
-  *GPFSEL1 = r;           // Write the new configuration.
-
-  // We also need to disable pull-up/down for pins 14 and 15.
-  *GPPUD = GPPUD_OFF;     // Set the configuration we want to write.
-  wait_cycles(150);       // Wait for 150 cycles.
-  *GPPUDCLK0 = BIT_U32(14) | BIT_U32(15); // Assert clock on pins 14 and 15.
-  wait_cycles(150);       // Wait for 150 cycles again.
-  *GPPUD = GPPUD_OFF;     // Write to GPPUD (is it necessary?).
-  *GPPUDCLK0 = 0;         // Remove the clock on pins 14 and 15.
+  // We first need to map UART1 to the GPIO pins: we set the function of pins
+  // 14 and 15 to alternative 5, and disable their pull-up/down.
+  u64 pins = (1ULL << 14) | (1ULL << 15);
+  gpio_set_function_mask(pins, GPFSEL_ALT5);
+  gpio_pull(pins, GPPUD_OFF);
 
   // We can now initialise UART1 (mini UART), which we must first enable.
   *AUX_ENABLES |= AUX_ENABLES_BIT_UART1;
@@ -47,24 +32,66 @@ void uart1_init(){
   *AUX_MU_CNTL_REG = AUX_MU_CNTL_RX_ENABLE | AUX_MU_CNTL_TX_ENABLE;
 }
 
-void uart1_putc(char c){
-  // Wait until the FIFO can accept at least one byte.
+void uart1_raw_putc(char c){
+  // Wait until the FIFO can accept at least one byte (letting other threads
+  // run in the meantime).
   while(!(*AUX_MU_LSR_REG & AUX_MU_LSR_TX_EMPTY)) {
-    asm volatile("nop");
+    thread_yield();
   }
 
   // Write to the buffer.
   *AUX_MU_IO_REG = (u32) c;
 }
 
-void uart1_puts(const char *s){
+// Output of the functions below: either directly the UART, or a buffer that is
+// given to the console core (see "kernel/console.h") when full, or when done.
+typedef struct {
+  bool buffered;                  // Use the buffer (instead of the UART)?
+  u64 len;                        // Number of characters in the buffer.
+  char buf[CONSOLE_RECORD_TEXT];  // The buffer (one console record).
+} output;
+
+static void out_init(output *o){
+  o->buffered = console_enabled() && smp_core_id() != console_core();
+  o->len = 0;
+}
+
+static void out_flush(output *o){
+  if(o->len > 0) console_write(o->buf, o->len);
+  o->len = 0;
+}
+
+static void out_putc(output *o, char c){
+  if(!o->buffered){
+    uart1_raw_putc(c);
+    return;
+  }
+  if(o->len == CONSOLE_RECORD_TEXT) out_flush(o);
+  o->buf[o->len++] = c;
+}
+
+static void out_puts(output *o, const char *s){
   while(*s){
-    if(*s == '\n') uart1_putc('\r');
-    uart1_putc(*s);
+    if(*s == '\n') out_putc(o, '\r');
+    out_putc(o, *s);
     s++;
   }
 }
 
+void uart1_putc(char c){
+  output o;
+  out_init(&o);
+  out_putc(&o, c);
+  out_flush(&o);
+}
+
+void uart1_puts(const char *s){
+  output o;
+  out_init(&o);
+  out_puts(&o, s);
+  out_flush(&o);
+}
+
 void uart1_printf(const char *format, ...){
   const char *s = format;
   unsigned char b; // Used for the "%b" format string directive.
@@ -73,38 +100,43 @@ void uart1_printf(const char *format, ...){
   int i, d, q, r;
 
   // We need a character buffer for printing decimal representations.
-  char buf[20]; // 64-bit integers have at most 19 decimal digits.
+  char buf[21]; // 64-bit integers have at most 20 decimal digits.
   int pos;      // Position in the bufer.
 
+  output o;
+  out_init(&o);
+
   va_list ap;
   va_start(ap, format);
 
   while(*s){
     switch(*s){
     case '\n':
-      uart1_putc('\r');
-      uart1_putc('\n');
+      out_putc(&o, '\r');
+      out_putc(&o, '\n');
       s++;
       break;
     case '%':
       s++;
       switch(*s){
       case '\0':
-        uart1_puts("<MISSING MARKER>");
+        out_puts(&o, "<MISSING MARKER>");
+        out_flush(&o);
+        va_end(ap);
         return;
       case '%':
         // Escpade '%' character.
-        uart1_putc(*s);
+        out_putc(&o, *s);
         s++;
         break;
       case 's':
         // String.
-        uart1_puts(va_arg(ap, const char *));
+        out_puts(&o, va_arg(ap, const char *));
         s++;
         break;
       case 'c':
         // Character.
-        uart1_putc((char) va_arg(ap, int));
+        out_putc(&o, (char) va_arg(ap, int));
         s++;
         break;
       case 'b':
@@ -113,9 +145,9 @@ void uart1_printf(const char *format, ...){
         for(i = 4; i >= 0; i -= 4){
           d = (b >> i) & 0xf;
           if(d <= 0x9){
-            uart1_putc('0' + (char) d);
+            out_putc(&o, '0' + (char) d);
           } else {
-            uart1_putc('a' + (char) (d - 10));
+            out_putc(&o, 'a' + (char) (d - 10));
           }
         }
         s++;
@@ -126,9 +158,9 @@ void uart1_printf(const char *format, ...){
         for(i = 60; i >= 0; i -= 4){
           d = (w >> i) & 0xf;
           if(d <= 0x9){
-            uart1_putc('0' + (char) d);
+            out_putc(&o, '0' + (char) d);
           } else {
-            uart1_putc('a' + (char) (d - 10));
+            out_putc(&o, 'a' + (char) (d - 10));
           }
         }
         s++;
@@ -139,9 +171,9 @@ void uart1_printf(const char *format, ...){
         for(i = 28; i >= 0; i -= 4){
           d = (h >> i) & 0xf;
           if(d <= 0x9){
-            uart1_putc('0' + (char) d);
+            out_putc(&o, '0' + (char) d);
           } else {
-            uart1_putc('a' + (char) (d - 10));
+            out_putc(&o, 'a' + (char) (d - 10));
           }
         }
         s++;
@@ -149,7 +181,7 @@ void uart1_printf(const char *format, ...){
       case 'i':
         // Decimal representation for an integer (int).
         i = va_arg(ap, int);
-        if(i < 0) uart1_putc('-');
+        if(i < 0) out_putc(&o, '-');
         q = ABS(i / 10);
         r = ABS(i % 10);
         pos = 19;
@@ -159,27 +191,41 @@ void uart1_printf(const char *format, ...){
           r = q % 10;
           q = q / 10;
         } while(q != 0 || r != 0);
-        uart1_puts(&(buf[pos+1]));
+        out_puts(&o, &(buf[pos+1]));
+        s++;
+        break;
+      case 'u':
+        // Decimal representation for an unsigned word (u64).
+        w = va_arg(ap, u64);
+        pos = 20;
+        buf[pos--] = '\0';
+        do {
+          buf[pos--] = (char) ('0' + w % 10);
+          w = w / 10;
+        } while(w != 0);
+        out_puts(&o, &(buf[pos+1]));
         s++;
         break;
       default:
-        uart1_puts("<BAD MARKER \""); uart1_putc(*s); uart1_puts("\">");
+        out_puts(&o, "<BAD MARKER \""); out_putc(&o, *s); out_puts(&o, "\">");
         s++;
       }
       break;
     default:
-      uart1_putc(*s);
+      out_putc(&o, *s);
       s++;
     }
   }
 
+  out_flush(&o);
   va_end(ap);
 }
 
 char uart1_getc() {
-  // Wait until the FIFO hold at least one byte.
+  // Wait until the FIFO hold at least one byte (letting other threads run in
+  // the meantime).
   while(!(*AUX_MU_LSR_REG & AUX_MU_LSR_DATA_READY)){
-    asm volatile("nop");
+    thread_yield();
   }
 
   // Read a character.
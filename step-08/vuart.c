@@ -0,0 +1,182 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <aarch64/atomic.h>
+#include <bcm2837/auxiliaries.h>
+#include <kernel/mmiotrace.h>
+#include <kernel/queue.h>
+#include <kernel/smp.h>
+#include <kernel/stage2.h>
+#include <kernel/vuart.h>
+
+// Page of the auxiliaries (containing the UART1 registers).
+#define AUX_PAGE  ((u64) AUX_IRQ)
+#define PAGE_SIZE 0x1000ULL
+
+SPSC_QUEUE_DEFINE(vuart_queue, char, VUART_BUFFER_SIZE)
+
+// State of the module, in the memory private to EL2 (zeroed at boot).
+#define HYP __attribute__((section(".hyp")))
+
+// Buffer of each core. Each is only filled by its own core, and emptied by the
+// core holding the lock.
+static vuart_queue buffers[NB_CORES] HYP;
+
+static volatile u64 emulating HYP; // Are accesses trapped?
+static volatile u64 stopping HYP;  // Is emulation being turned off?
+static volatile u64 lock HYP;      // Held while writing to the real UART.
+static u64 current HYP;            // Core whose line is being written.
+
+// Statistics of each core.
+typedef struct {
+  u64 nb_traps;
+  u64 nb_chars;
+  u64 nb_batches;
+  u64 max_batch;
+} __attribute__((aligned(64))) core_stats;
+
+static core_stats stats[NB_CORES] HYP;
+
+// Buffer with characters to write: that of the current line if there is one,
+// or the first non-empty buffer (or NULL if there are none).
+static vuart_queue *next_buffer(){
+  if(current < NB_CORES && vuart_queue_peek(&(buffers[current]))){
+    return &(buffers[current]);
+  }
+  for(u64 core = 0; core < NB_CORES; core++){
+    if(vuart_queue_peek(&(buffers[core]))){
+      current = core;
+      return &(buffers[core]);
+    }
+  }
+  return NULL;
+}
+
+// Write buffered characters to the real UART for as long as it accepts them,
+// or (if wait is set) until all buffers are empty. Without wait, nothing is
+// done if another core holds the lock.
+static void drain(bool wait){
+  while(!atomic_cas(&lock, 0, 1)){
+    if(!wait) return;
+  }
+
+  u64 n = 0;
+  vuart_queue *q;
+  while((q = next_buffer()) != NULL){
+    if(!(*AUX_MU_LSR_REG & AUX_MU_LSR_TX_EMPTY)){
+      if(!wait) break;
+      continue;
+    }
+    char c;
+    vuart_queue_pop(q, &c);
+    *AUX_MU_IO_REG = (u32) c;
+    if(c == '\n') current = NB_CORES;
+    n++;
+  }
+
+  atomic_store_release(&lock, 0);
+
+  if(n == 0) return;
+  core_stats *s = &(stats[smp_core_id()]);
+  s->nb_batches++;
+  if(n > s->max_batch) s->max_batch = n;
+}
+
+void vuart_init(){
+  for(u64 core = 0; core < NB_CORES; core++){
+    vuart_queue_init(&(buffers[core]));
+  }
+  current = NB_CORES;
+  vuart_ctl(VUART_ON);
+}
+
+bool vuart_ctl(u64 op){
+  switch(op){
+    case VUART_OFF:
+      if(!emulating) return true;
+      // Buffered characters are written before EL1 gets direct access, so
+      // that they cannot be overtaken by its next writes. Meanwhile, trapped
+      // writes wait for their character to be written.
+      stopping = 1;
+      dmb_ish();
+      drain(true);
+      stage2_protect(AUX_PAGE, PAGE_SIZE, S2_RW);
+      mmiotrace_remap();
+      emulating = 0;
+      stopping = 0;
+      return true;
+    case VUART_ON:
+      if(emulating) return true;
+      emulating = 1;
+      return stage2_protect(AUX_PAGE, PAGE_SIZE, S2_NONE);
+    case VUART_FLUSH:
+      drain(true);
+      return true;
+    default:
+      return false;
+  }
+}
+
+void vuart_remap(){
+  if(emulating) stage2_protect(AUX_PAGE, PAGE_SIZE, S2_NONE);
+}
+
+bool vuart_data_abort(hvc_frame *f, u64 esr){
+  if(!emulating) return false;
+  u64 ipa = stage2_fault_ipa();
+  if(ipa < AUX_PAGE || ipa >= AUX_PAGE + PAGE_SIZE) return false;
+
+  // Only single register accesses (with a valid syndrome) are emulated.
+  if(!(esr & ISS_ISV)) return false;
+
+  core_stats *s = &(stats[smp_core_id()]);
+  s->nb_traps++;
+
+  volatile u32 *reg = (volatile u32 *) ipa;
+  u64 rt = ISS_SRT(esr);
+  u32 v = rt == 31 ? 0 : (u32) f->x[rt];
+  bool write = esr & ISS_WNR;
+
+  if(reg == AUX_MU_IO_REG && write){
+    vuart_queue *q = &(buffers[smp_core_id()]);
+    char c = (char) v;
+    while(!vuart_queue_push(q, &c)){
+      drain(true);
+    }
+    s->nb_chars++;
+  } else if(reg == AUX_MU_LSR_REG && !write){
+    v = *reg | AUX_MU_LSR_TX_EMPTY | AUX_MU_LSR_TX_IDLE;
+  } else if(write){
+    *reg = v;
+  } else {
+    v = *reg;
+  }
+
+  if(!write && rt != 31) f->x[rt] = v;
+  f->elr += 4;
+
+  // Once emulation is being turned off, the next write of EL1 may go to the
+  // real UART directly: the buffers must be empty before returning.
+  dmb_ish();
+  drain(stopping || !emulating);
+  return true;
+}
+
+bool vuart_emulating(){
+  return emulating;
+}
+
+void vuart_get_stats(vuart_stats *s){
+  s->nb_traps = 0;
+  s->nb_chars = 0;
+  s->nb_batches = 0;
+  s->max_batch = 0;
+  for(u64 core = 0; core < NB_CORES; core++){
+    s->nb_traps += stats[core].nb_traps;
+    s->nb_chars += stats[core].nb_chars;
+    s->nb_batches += stats[core].nb_batches;
+    if(stats[core].max_batch > s->max_batch){
+      s->max_batch = stats[core].max_batch;
+    }
+  }
+}
@@ -0,0 +1,251 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <types.h>
+#include <macros.h>
+#include <aarch64/atomic.h>
+#include <aarch64/cache.h>
+#include <kernel/smp.h>
+#include <kernel/wsched.h>
+
+// Capacity of a deque (must be a power of two). When a deque is full, tasks
+// are simply not split further, so this only limits available parallelism.
+#define DEQUE_SIZE 256
+#define DEQUE_MASK (DEQUE_SIZE - 1)
+
+// Chase-Lev deque (following "Correct and Efficient Work-Stealing for Weak
+// Memory Models", Lê et al., PPoPP 2013), with a fixed-size buffer. The top
+// index (modified by thieves) and the bottom index (modified by the owner)
+// live on separate cache lines to avoid false sharing.
+typedef struct {
+  volatile u64 top;    // Index of the next task to steal.
+  u8 pad_top[CACHE_LINE_SIZE - sizeof(u64)];
+  volatile u64 bottom; // Index of the next free slot.
+  u8 pad_bottom[CACHE_LINE_SIZE - sizeof(u64)];
+  task buf[DEQUE_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE))) wsdeque;
+
+// Per-core scheduler data (one cache line per core).
+typedef struct {
+  u64 seed;   // State of the random generator used to pick victims.
+  u64 tasks;  // Number of tasks run.
+  u64 steals; // Number of tasks stolen.
+} __attribute__((aligned(CACHE_LINE_SIZE))) wscore;
+
+// Return values of "deque_steal".
+#define STEAL_OK    0 // A task was stolen.
+#define STEAL_EMPTY 1 // The deque was empty.
+#define STEAL_ABORT 2 // We lost a race against another thief (or the owner).
+
+static wsdeque deques[NB_CORES];
+static wscore cores[NB_CORES];
+
+static u64 pool_size = NB_CORES;     // Number of cores in the pool.
+static u64 pool_depth = 0;           // Nesting depth of "wsched_start".
+static u64 pool_workers = 0;         // Mask of cores running "worker_loop".
+static volatile u64 pool_running = 0;
+
+// Push a task at the bottom of deque d (owner only). Returns false if full.
+static bool deque_push(wsdeque *d, const task *t){
+  i64 b = (i64) d->bottom;
+  i64 top = (i64) atomic_load_acquire(&d->top);
+  if(b - top >= DEQUE_SIZE) return false;
+
+  d->buf[b & DEQUE_MASK] = *t;
+  dmb_ish(); // The task must be visible before the new bottom.
+  d->bottom = (u64) (b + 1);
+  return true;
+}
+
+// Take a task from the bottom of deque d (owner only). Returns false if empty.
+static bool deque_take(wsdeque *d, task *t){
+  i64 b = (i64) d->bottom - 1;
+  d->bottom = (u64) b;
+  dmb_ish(); // The new bottom must be visible before we read top.
+  i64 top = (i64) d->top;
+
+  if(top > b){
+    // The deque was empty.
+    d->bottom = (u64) (b + 1);
+    return false;
+  }
+
+  *t = d->buf[b & DEQUE_MASK];
+  if(top < b) return true;
+
+  // Last task: race against thieves for it.
+  bool won = atomic_cas(&d->top, (u64) top, (u64) (top + 1));
+  d->bottom = (u64) (b + 1);
+  return won;
+}
+
+// Steal a task from the top of deque d (any core).
+static int deque_steal(wsdeque *d, task *t){
+  i64 top = (i64) atomic_load_acquire(&d->top);
+  dmb_ish(); // Read top before bottom.
+  i64 b = (i64) atomic_load_acquire(&d->bottom);
+  if(top >= b) return STEAL_EMPTY;
+
+  // The slot cannot be overwritten before top moves (see "deque_push").
+  *t = d->buf[top & DEQUE_MASK];
+  if(!atomic_cas(&d->top, (u64) top, (u64) (top + 1))) return STEAL_ABORT;
+  return STEAL_OK;
+}
+
+// Xorshift pseudo-random number generator.
+static u64 next_random(u64 *seed){
+  u64 x = *seed;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *seed = x;
+  return x;
+}
+
+// Find a task for the given core: first in its own deque, then by stealing
+// from the other cores (starting from a random victim). All the deques are
+// tried, not only those of the pool: the core spawning tasks may be outside of
+// it, or the pool may have shrunk while tasks were queued.
+static bool find_task(u64 core, task *t){
+  if(deque_take(&(deques[core]), t)) return true;
+
+  wscore *c = &(cores[core]);
+  if(c->seed == 0) c->seed = 0x9e3779b97f4a7c15ULL * (core + 1);
+  u64 start = next_random(&c->seed) % NB_CORES;
+  for(u64 i = 0; i < NB_CORES; i++){
+    u64 victim = (start + i) % NB_CORES;
+    if(victim == core) continue;
+    if(deque_steal(&(deques[victim]), t) == STEAL_OK){
+      c->steals++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Run task t on the given core, splitting its range first.
+static void run_task(u64 core, task *t){
+  u64 grain = t->grain ? t->grain : 1;
+
+  while(t->end - t->begin > grain){
+    task upper = *t;
+    upper.begin = t->begin + (t->end - t->begin) / 2;
+
+    atomic_fetch_add(&t->group->pending, 1);
+    if(!deque_push(&(deques[core]), &upper)){
+      // Full deque: run the whole remaining range ourselves.
+      atomic_fetch_add(&t->group->pending, (u64) -1);
+      break;
+    }
+    sev(); // Wake up idle workers.
+
+    t->end = upper.begin;
+  }
+
+  t->fn(t->begin, t->end, t->arg);
+  cores[core].tasks++;
+
+  // Release semantics: the effects of the task are visible to waiters.
+  atomic_fetch_add(&t->group->pending, (u64) -1);
+}
+
+// Main loop of the cores of the pool (except for the one calling "wait").
+static void worker_loop(void *arg){
+  UNUSED(arg);
+  u64 core = smp_core_id();
+  task t;
+
+  while(atomic_load_acquire(&pool_running)){
+    if(find_task(core, &t)){
+      run_task(core, &t);
+    } else {
+      wfe(); // Woken up by pushes, and when the pool stops.
+    }
+  }
+}
+
+void wsched_set_cores(u64 n){
+  if(n < 1) n = 1;
+  if(n > NB_CORES) n = NB_CORES;
+  pool_size = n;
+}
+
+u64 wsched_cores(){
+  return pool_size;
+}
+
+void wsched_start(){
+  if(pool_depth++ > 0) return;
+
+  atomic_store_release(&pool_running, 1);
+  pool_workers = 0;
+  for(u64 core = 0; core < pool_size; core++){
+    if(smp_run_on(core, worker_loop, NULL)) pool_workers |= 1ULL << core;
+  }
+}
+
+void wsched_stop(){
+  if(pool_depth == 0 || --pool_depth > 0) return;
+
+  atomic_store_release(&pool_running, 0);
+  sev();
+  for(u64 core = 0; core < NB_CORES; core++){
+    if((pool_workers >> core) & 1) smp_wait(core);
+  }
+  pool_workers = 0;
+}
+
+void task_group_init(task_group *g){
+  g->pending = 0;
+}
+
+void task_spawn(task_group *g, range_fn fn, u64 begin, u64 end, u64 grain,
+                void *arg){
+  if(begin >= end) return;
+
+  task t = {
+    .fn = fn, .arg = arg, .begin = begin, .end = end, .grain = grain, .group = g
+  };
+  u64 core = smp_core_id();
+
+  atomic_fetch_add(&g->pending, 1);
+  if(!deque_push(&(deques[core]), &t)){
+    run_task(core, &t);
+    return;
+  }
+  sev();
+}
+
+void task_group_wait(task_group *g){
+  u64 core = smp_core_id();
+  task t;
+
+  while(atomic_load_acquire(&g->pending) != 0){
+    if(find_task(core, &t)) run_task(core, &t);
+  }
+}
+
+void parallel_for(u64 begin, u64 end, u64 grain, range_fn fn, void *arg){
+  task_group g;
+  task_group_init(&g);
+
+  wsched_start();
+  task_spawn(&g, fn, begin, end, grain, arg);
+  task_group_wait(&g);
+  wsched_stop();
+}
+
+u64 wsched_nb_tasks(u64 core){
+  return core < NB_CORES ? cores[core].tasks : 0;
+}
+
+u64 wsched_nb_steals(u64 core){
+  return core < NB_CORES ? cores[core].steals : 0;
+}
+
+void wsched_reset_stats(){
+  for(u64 core = 0; core < NB_CORES; core++){
+    cores[core].tasks = 0;
+    cores[core].steals = 0;
+  }
+}